@@ -0,0 +1,120 @@
+#ifndef INDENT_H
+#define INDENT_H
+
+/* ================= INDENTATION =================
+ * Block structure of a layout language (def->layout: Python) from the
+ * tokens of the lexing pass, with no second look at the lines. The lexer
+ * ends every logical line with a TOK_NEWLINE; the first token after one is
+ * measured here against a stack of the open blocks' indentation, and the
+ * blocks it opens or closes come out as TOK_INDENT and TOK_DEDENT tokens
+ * to pass on before it. Blank and comment lines make no tokens, and lines
+ * inside brackets or after a '\' are not logical lines, so none of them
+ * counts.
+ *
+ * It sits on top of any token source over the lexer's buffer:
+ *
+ *   IndentStack is;
+ *   indentOpen(&is, &lx);
+ *   while (lexer_next(&lx, &t)) {          // or parNext(), streamNext()
+ *       while (indentNext(&is, &t, &d))
+ *           ...                            d: INDENT or DEDENT before t
+ *       ...                                t
+ *   }
+ *   while (indentNext(&is, &t, &d))
+ *       ...                                t is TOK_EOF: close every block
+ *
+ * A tab moves to the next multiple of 8 columns and a form feed starts the
+ * count over, as in Python. A dedent to a width no open block has closes
+ * the blocks down to the nearest narrower one; past INDENT_MAX_DEPTH
+ * blocks (Python's own limit) a deeper line opens none.
+ */
+#include "lexer.h"
+
+#define INDENT_MAX_DEPTH 100
+
+typedef struct indentStack {
+    const Lexer *lx;         // whose buffer the tokens point into
+    int atLineStart;         // the next token begins a logical line
+    int measured;            // indentNext() is handing out the current token's blocks
+    int width;               // its indentation
+    const char *at;          // and where it starts
+    int col;
+    int depth;               // blocks open
+    int levels[INDENT_MAX_DEPTH];    // their indentation; levels[0] is the top level, 0
+} IndentStack;
+
+static inline void indentOpen(IndentStack *is, const Lexer *lx) {
+    memset(is, 0, sizeof(*is));
+    is->lx = lx;
+    is->atLineStart = 1;
+}
+
+/* Columns the blanks [p, p+n) indent a line by. Spaces are the usual
+ * case, so the tabs and form feeds are found with scan->maskAny(), 64
+ * bytes at a time, and only they are looked at one by one. The mask is
+ * taken over the rest of the buffer and cut to the n bytes, so even a
+ * short indentation gets the vector kernel. */
+static inline int indentWidth(const Lexer *lx, const char *p, size_t n) {
+    const char *end = lx->src.data + lx->src.len;
+    int width = 0;
+    for (size_t done = 0; done < n; done += 64) {
+        uint64_t mask = lx->scan->maskAny(p + done, end, "\t\f");
+        if (n - done < 64) mask &= (1ull << (n - done)) - 1;
+        size_t from = done;    // bytes before each tab or form feed are a column each
+        for (; mask; mask &= mask - 1) {
+            size_t at = done + __builtin_ctzll(mask);
+            width += (int)(at - from);
+            width = p[at] == '\t' ? (width / 8 + 1) * 8 : 0;
+            from = at + 1;
+        }
+        width += (int)((n - done < 64 ? n : done + 64) - from);
+    }
+    return width;
+}
+
+/* Measure t, the first token of a logical line: its indentation runs from
+ * the start of its line to its first byte. */
+static inline void indentMeasure(IndentStack *is, const Token *t) {
+    is->at = t->text.ptr - t->quotes;
+    is->col = t->col;
+    is->width = t->kind == TOK_EOF ? 0 : indentWidth(is->lx, is->at - (is->col - 1), is->col - 1);
+}
+
+static inline void indentToken(Token *d, TokenKind kind, const char *p, int len, int row, int col) {
+    memset(d, 0, sizeof(*d));
+    d->kind = kind;
+    d->text.ptr = p;
+    d->text.len = len;
+    d->row = row;
+    d->col = col;
+    d->keyword = -1;
+}
+
+/* Fill d with the next INDENT or DEDENT to come before t and return 1,
+ * or return 0 once t itself is next. Call until it returns 0 for every
+ * token, and after the last for the TOK_EOF one. */
+static inline int indentNext(IndentStack *is, const Token *t, Token *d) {
+    if (!is->measured) {
+        if (!is->atLineStart && t->kind != TOK_EOF) {
+            is->atLineStart = t->kind == TOK_NEWLINE;
+            return 0;
+        }
+        indentMeasure(is, t);
+        is->measured = 1;
+        if (is->width > is->levels[is->depth] && is->depth + 1 < INDENT_MAX_DEPTH) {
+            is->levels[++is->depth] = is->width;
+            indentToken(d, TOK_INDENT, is->at - (is->col - 1), is->col - 1, t->row, 1);
+            return 1;
+        }
+    }
+    if (is->width < is->levels[is->depth]) {
+        is->depth--;
+        indentToken(d, TOK_DEDENT, is->at, 0, t->row, is->col);
+        return 1;
+    }
+    is->measured = 0;
+    is->atLineStart = t->kind == TOK_NEWLINE;
+    return 0;
+}
+
+#endif
@@ -0,0 +1,22 @@
+# comment
+import os
+def foo(a, b):
+    """docstring
+    multi"""
+    x = a + b
+    if x >= 10:
+        return x
+    y = 'single'
+    z = "double"
+    return bar(x, y)
+class K:
+    def method(self):
+        pass
+print(foo(1, 2))
+x += 1; y -= 2; w == 3
+x = (
+    """a"""
+)
+s = '''one
+two''' + \
+    """three"""
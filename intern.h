@@ -0,0 +1,81 @@
+#ifndef INTERN_H
+#define INTERN_H
+
+/* ================= STRING POOL =================
+ * Interning arena for symbol names. Every distinct string is stored once,
+ * NUL terminated, in a single growing byte array and is referred to by a
+ * 32-bit id handed out in first-seen order, so records hold ids instead of
+ * char arrays and two names are equal exactly when their ids are.
+ */
+#include "symtab.h"
+
+typedef struct stringPool {
+    char *bytes;          // all strings back to back
+    uint32_t used, cap;
+    uint32_t *offsets;    // id -> start in bytes; offsets[count] == used
+    uint32_t count, idCap;
+    HashIndex index;
+} StringPool;
+
+typedef struct poolKey {
+    const StringPool *pool;
+    const char *ptr;
+    int len;
+} PoolKey;
+
+static inline const char *poolString(const StringPool *p, uint32_t id) {
+    return p->bytes + p->offsets[id];
+}
+
+static inline int poolLength(const StringPool *p, uint32_t id) {
+    return p->offsets[id + 1] - p->offsets[id] - 1;
+}
+
+static inline int poolMatches(const void *key, uint32_t id) {
+    const PoolKey *k = key;
+    return poolLength(k->pool, id) == k->len &&
+           memcmp(poolString(k->pool, id), k->ptr, k->len) == 0;
+}
+
+/* Id of s, adding it to the pool the first time it is seen. */
+static uint32_t poolIntern(StringPool *p, const char *s, int len) {
+    PoolKey key = { p, s, len };
+    uint32_t h = hashBytes(s, len);
+    int found = hiFind(&p->index, h, poolMatches, &key);
+    if (found >= 0) return found;
+
+    if (p->used + len + 1 > p->cap) {
+        while (p->used + len + 1 > p->cap) p->cap = p->cap ? p->cap * 2 : 4096;
+        p->bytes = realloc(p->bytes, p->cap);
+    }
+    if (p->count + 2 > p->idCap) {
+        p->idCap = p->idCap ? p->idCap * 2 : 256;
+        p->offsets = realloc(p->offsets, p->idCap * sizeof(uint32_t));
+        if (p->count == 0) p->offsets[0] = 0;
+    }
+    memcpy(p->bytes + p->used, s, len);
+    p->bytes[p->used + len] = '\0';
+    p->used += len + 1;
+    p->offsets[p->count + 1] = p->used;
+    hiInsert(&p->index, h, p->count);
+    return p->count++;
+}
+
+static inline uint32_t poolInternString(StringPool *p, const char *s) {
+    return poolIntern(p, s, strlen(s));
+}
+
+/* Forget every string but keep the memory for reuse. */
+static inline void poolClear(StringPool *p) {
+    p->used = p->count = 0;
+    hiClear(&p->index);
+}
+
+static inline void poolFree(StringPool *p) {
+    free(p->bytes);
+    free(p->offsets);
+    hiFree(&p->index);
+    memset(p, 0, sizeof(*p));
+}
+
+#endif
@@ -1,172 +1,120 @@
-#include <stdio.h>
-#include <stdlib.h>
-#include <ctype.h>
-#include <string.h>
-
-#define TABLE_SIZE 50
-
-/* ---------------- SYMBOL TABLE -------------------- */
-typedef struct node {
-    char name[50];
-    char type[20];
-    char argument[100];
-    struct node *next;
-} Node;
-
-Node *symbolTable[TABLE_SIZE] = {NULL};
-
-int hashFunction(char *str) {
-    int sum = 0;
-    for (int i=0; str[i]!='\0'; i++) sum += str[i];
-    return sum % TABLE_SIZE;
-}
-
-void insertSymbol(char *name, char *type, char *arg){
-    int index = hashFunction(name);
-    Node *temp = symbolTable[index];
-    while(temp){ if(strcmp(temp->name,name)==0) return; temp=temp->next; }
-    Node *newNode = (Node*)malloc(sizeof(Node));
-    strcpy(newNode->name,name);
-    strcpy(newNode->type,type);
-    if(arg) strcpy(newNode->argument,arg); else strcpy(newNode->argument,"-");
-    newNode->next = symbolTable[index];
-    symbolTable[index] = newNode;
-}
-
-void printSymbolTable(){
-    printf("\n========== SYMBOL TABLE ==========\n");
-    printf("Name\tType\tArgument\n");
-    for(int i=0;i<TABLE_SIZE;i++){
-        Node *temp = symbolTable[i];
-        while(temp){ 
-            printf("%s\t%s\t%s\n", temp->name,temp->type,temp->argument);
-            temp=temp->next;
-        }
-    }
-}
-
-/* ---------------- JAVA KEYWORDS ------------------ */
-const char *keywords[] = {
-    "int","float","double","char","boolean","void",
-    "if","else","for","while","do","return","break","continue",
-    "public","private","protected","class","static","final","abstract",
-    "interface","extends","implements","try","catch","throw","throws",
-    "new","package","import","this","super","switch","case","default",
-    "enum","instanceof","synchronized"
-};
-
-int isKeyword(char *str){
-    int n = sizeof(keywords)/sizeof(keywords[0]);
-    for(int i=0;i<n;i++) if(strcmp(str,keywords[i])==0) return 1;
-    return 0;
-}
-
-/* ---------------- OPERATORS / DELIMITERS --------- */
-char single_ops[] = "+-*/%=<>!&|^";
-char delimiters[] = "(){}[],;:.";
-int isOperator(char c){ return strchr(single_ops,c)!=NULL; }
-int isDelimiter(char c){ return strchr(delimiters,c)!=NULL; }
-
-/* ---------------- COMMENTS ------------------------ */
-void skipCommentsJava(FILE *fp,int *row,int *col){
-    int ch=getc(fp);
-    if(ch=='/'){
-        int ch2=getc(fp);
-        if(ch2=='/'){ // single-line
-            while((ch=getc(fp))!='\n' && ch!=EOF);
-            if(ch=='\n'){ (*row)++; *col=1; }
-        } else if(ch2=='*'){ // multi-line
-            int prev=0;
-            while((ch=getc(fp))!=EOF){
-                if(ch=='\n'){ (*row)++; *col=1; } else (*col)++;
-                if(prev=='*' && ch=='/') break;
-                prev=ch;
-            }
-        } else ungetc(ch2,fp);
-    } else ungetc(ch,fp);
-}
-
-/* ---------------- IDENTIFIERS / FUNCTIONS -------- */
-void handleIdentifierJava(FILE *fp,int first,int row,int *col){
-    char buffer[100]; int i=0,ch;
-    buffer[i++]=first;
-    while((ch=getc(fp))!=EOF && (isalnum(ch)||ch=='_')) buffer[i++]=ch;
-    buffer[i]='\0';
-    if(ch!=EOF) ungetc(ch,fp);
-
-    if(isKeyword(buffer)){
-        printf("<KEYWORD,%s,%d,%d>\n",buffer,row,*col);
-    } else {
-        int next=fgetc(fp);
-        if(next=='('){ // method/function
-            printf("<FUNC,%s,%d,%d>\n",buffer,row,*col);
-            insertSymbol(buffer,"FUNC","-");
-        } else { // variable / class
-            printf("<IDENTIFIER,%s,%d,%d>\n",buffer,row,*col);
-            insertSymbol(buffer,"IDENTIFIER","-");
-            if(next!=EOF) ungetc(next,fp);
-        }
-    }
-    *col += strlen(buffer);
-}
-
-/* ---------------- NUMBERS ------------------------- */
-void handleNumberJava(FILE *fp,int first,int row,int *col){
-    char buffer[100]; int i=0,ch;
-    buffer[i++]=first;
-    while((ch=getc(fp))!=EOF && (isdigit(ch)||ch=='.')) buffer[i++]=ch;
-    buffer[i]='\0';
-    if(ch!=EOF) ungetc(ch,fp);
-    printf("<NUM,%s,%d,%d>\n",buffer,row,*col);
-    *col += strlen(buffer);
-}
-
-/* ---------------- STRING / CHAR ------------------- */
-void handleStringJava(FILE *fp,int row,int *col){
-    int ch,start=*col;
-    int quote=getc(fp); // ' or "
-    printf("<STRING,%c",quote); (*col)++;
-    while((ch=getc(fp))!=EOF && ch!=quote){ putchar(ch); (*col)++; }
-    printf(",%d,%d>\n",row,start); (*col)++;
-}
-
-/* ---------------- OPERATOR ------------------------ */
-void handleOperatorJava(FILE *fp,char ch,int row,int *col){
-    int next=getc(fp);
-    if(next=='=' || (ch=='<' && next=='=') || (ch=='>' && next=='=') || 
-       (ch=='&' && next=='&') || (ch=='|' && next=='|') ||
-       (ch=='+' && next=='+') || (ch=='-' && next=='-')){
-        printf("<OP,%c%c,%d,%d>\n",ch,next,row,*col);
-        (*col)+=2;
-    } else { if(next!=EOF) ungetc(next,fp);
-        printf("<OP,%c,%d,%d>\n",ch,row,*col); (*col)++;
-    }
-}
-
-/* ---------------- DELIMITER ----------------------- */
-void handleDelimiterJava(char c,int row,int *col){
-    printf("<DELIM,%c,%d,%d>\n",c,row,*col); (*col)++;
-}
-
-/* ---------------- MAIN LEXER ---------------------- */
-int main(){
-    FILE *fp=fopen("input.java","r");
-    if(!fp){ printf("Cannot open input.java\n"); return 1; }
-
-    int c,row=1,col=1;
-    while((c=getc(fp))!=EOF){
-        if(c=='\n'){ row++; col=1; }
-        else if(isspace(c)){ col++; }
-        else if(c=='/'){ skipCommentsJava(fp,&row,&col); }
-        else if(isalpha(c)||c=='_'){ handleIdentifierJava(fp,c,row,&col); }
-        else if(isdigit(c)){ handleNumberJava(fp,c,row,&col); }
-        else if(c=='"'||c=='\''){ handleStringJava(fp,row,&col); }
-        else if(isOperator(c)){ handleOperatorJava(fp,c,row,&col); }
-        else if(isDelimiter(c)){ handleDelimiterJava(c,row,&col); }
-        else { printf("Invalid token at %d %d\n",row,col); col++; }
-    }
-
-    fclose(fp);
-    printSymbolTable();
-    return 0;
-}
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "lexer.h"
+#include "parlex.h"
+#include "tokstore.h"
+#include "outbuf.h"
+#include "symsnap.h"
+#include "lexstream.h"
+
+
+/* ---------------- OUTPUT -------------------------- */
+const char *kindNames[TOK_KIND_COUNT] = {
+    [TOK_KEYWORD]="KEYWORD", [TOK_IDENTIFIER]="IDENTIFIER", [TOK_FUNC]="FUNC",
+    [TOK_NUMBER]="NUM", [TOK_OP]="OP", [TOK_DELIM]="DELIM"
+};
+
+int binaryOutput = 0;       // -b: tokens go to tokenFile instead of stdout
+TokenWriter tokenFile;
+OutBuf out;                 // stdout
+SymbolSpill spill;          // -S: symbols spilled while streaming
+
+void emit(const Token *t){
+    Lexeme lx=t->text;
+    if(binaryOutput){ twAppend(&tokenFile,t->kind,lx,t->row,t->col); return; }
+    if(t->kind==TOK_STRING){   // quote precedes lx
+        outStr(&out,"<STRING,"); outChar(&out,lx.ptr[-1]); outSpan(&out,lx.ptr,lx.len); outChar(&out,lx.ptr[-1]);
+    } else if(t->kind==TOK_INVALID){
+        outStr(&out,"Invalid token at "); outInt(&out,t->row); outChar(&out,' '); outInt(&out,t->col); outChar(&out,'\n');
+        return;
+    } else {
+        outChar(&out,'<'); outStr(&out,kindNames[t->kind]); outChar(&out,','); outSpan(&out,lx.ptr,lx.len);
+    }
+    outChar(&out,','); outInt(&out,t->row); outChar(&out,','); outInt(&out,t->col); outStr(&out,">\n");
+}
+
+/* ---------------- SYMBOL TABLE -------------------- */
+const char *symbolTypeNames[] = { "IDENTIFIER", "FUNC" };
+
+void printSymbols(OutBuf *o,const Lexer *lexer){
+    for(uint32_t i=0;i<lexer->symbolCount;i++){
+        const Symbol *temp = &lexer->symbols[i];
+        outStr(o,poolString(&lexer->names,temp->name)); outChar(o,'\t');
+        outStr(o,symbolTypeNames[temp->type]); outStr(o,"\t-\n");
+    }
+}
+
+void printSymbolTable(const Lexer *lexer){
+    outStr(&out,"\n========== SYMBOL TABLE ==========\n");
+    outStr(&out,"Name\tType\tArgument\n");
+    if(spill.fp) spillReplay(&spill,&out);
+    printSymbols(&out,lexer);
+}
+
+/* ---------------- MAIN LEXER ---------------------- */
+int main(int argc, char **argv){
+    const char *binPath = NULL, *snapPath = NULL;
+    int threads = 1, stats = 0;    // stats: 1 = --stats, 2 = --stats=json
+    int streaming = 0, symbolLimit = 0;
+    for(int i=1;i<argc;i++){
+        if(strcmp(argv[i],"-b")==0 && i+1<argc) binPath=argv[++i];
+        else if(strcmp(argv[i],"-s")==0 && i+1<argc) snapPath=argv[++i];
+        else if(strcmp(argv[i],"-j")==0 && i+1<argc) threads=atoi(argv[++i]);
+        else if(strcmp(argv[i],"-")==0) streaming=1;
+        else if(strcmp(argv[i],"-S")==0 && i+1<argc) symbolLimit=atoi(argv[++i]);
+        else if(strcmp(argv[i],"--stats")==0) stats=1;
+        else if(strcmp(argv[i],"--stats=json")==0) stats=2;
+        else { printf("usage: %s [-b tokens.bin] [-s symbols.snap] [-j threads] [--stats[=json]] [- [-S symbols]]\n",argv[0]); return 1; }
+    }
+    if(streaming ? binPath || threads>1 : symbolLimit>0){ printf("-S needs -, which cannot be combined with -b or -j\n"); return 1; }
+    if(symbolLimit>0 && snapPath){ printf("-S cannot be combined with -s\n"); return 1; }
+    Source src = { 0 };
+    uint64_t started=statTick();
+    if(!streaming && srcOpen(&src,"input.java")!=0){ printf("Cannot open input.java\n"); return 1; }
+    Lexer lexer;
+    if(lexer_open(&lexer,src.data,src.len,LANG_JAVA)!=0){
+        printf("Cannot build keyword table\n"); return 1;
+    }
+    lexer_stats_input(&lexer,started);
+    outOpen(&out,STDOUT_FILENO);
+    if(binPath){
+        if(twOpen(&tokenFile,binPath,src.data)!=0){ printf("Cannot open %s\n",binPath); return 1; }
+        binaryOutput=1;
+    }
+
+    Token t;
+    if(streaming){
+        LexStream ls;
+        if(streamOpen(&ls,&lexer,STDIN_FILENO,STREAM_WINDOW)!=0){ printf("Out of memory\n"); return 1; }
+        if(symbolLimit>0){
+            if(spillOpen(&spill,printSymbols)!=0){ printf("Cannot create a spill file\n"); return 1; }
+            streamSpillAt(&ls,symbolLimit,spillSymbols,&spill);
+        }
+        while(streamNext(&ls,&t)) emit(&t);
+        int error=ls.error;
+        streamClose(&ls);
+        if(error){ outFlush(&out); printf("Cannot read input: %s\n",strerror(error)); return 1; }
+    } else if(threads>1){
+        WorkPool wp; ParLexer pl;
+        if(wpStart(&wp,threads)!=0){ printf("Cannot start worker threads\n"); return 1; }
+        parOpen(&pl,&lexer,&wp,PAR_CHUNK);
+        while(parNext(&pl,&t)) emit(&t);
+        parClose(&pl);
+        wpStop(&wp);
+    } else {
+        while(lexer_next(&lexer,&t)) emit(&t);
+    }
+
+    if(binaryOutput && twClose(&tokenFile)!=0){ printf("Cannot write %s\n",binPath); return 1; }
+    if(snapPath && snapSave(&lexer,snapPath)!=0){ printf("Cannot write %s\n",snapPath); return 1; }
+    uint64_t printed=statTick();
+    printSymbolTable(&lexer);
+    if(outFlush(&out)!=0) return 1;
+    lexer_stats_charge(&lexer,ST_OUTPUT,printed);
+    if(stats) lexer_stats_report(&lexer,stderr,stats==2);
+    lexer_close(&lexer);
+    spillClose(&spill);
+    srcClose(&src);
+    return 0;
+}
@@ -0,0 +1,153 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+#include <time.h>
+#include "kwhash.h"
+#include "languages.h"
+
+/* Keyword recognition micro-benchmark: the old linear strncmp scan versus
+ * the perfect hash, over the same identifier stream for every language,
+ * with each language's keywords taken from its descriptor (languages.h).
+ * Then SQL's keywords three ways over upper, lower and mixed-case dumps:
+ * the exact hash, which only knows them in upper case, upper-casing a copy
+ * of each word before that lookup, and the caseless hash.
+ *
+ *   cc -O2 kwbench.c -o kwbench && ./kwbench [identifiers]
+ */
+
+#define DEFAULT_IDS 2000000
+#define KEYWORD_PERCENT 30
+
+/* The obvious way to ignore case: upper-case a copy, then look it up. */
+int copyKeyword(const KeywordTable *kw, const char *s, int len) {
+    char word[64];
+    if (len > (int)sizeof(word)) return -1;
+    for (int i = 0; i < len; i++) word[i] = toupper((unsigned char)s[i]);
+    return kwLookup(kw, word, len);
+}
+
+/* The lookup the lexers used before the perfect hash. */
+int linearKeyword(const char **words, int count, const char *s, int len) {
+    for (int i = 0; i < count; i++)
+        if (strncmp(s, words[i], len) == 0 && words[i][len] == '\0')
+            return i;
+    return -1;
+}
+
+double now() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+/* Fill text with n identifiers, KEYWORD_PERCENT of them keywords. A
+ * caseless language's are upper-case, like SQL's keyword list. */
+void makeIdentifiers(const LanguageDef *def, int n, char *text, int *offs, int *lens) {
+    unsigned state = 12345;
+    int pos = 0;
+    for (int i = 0; i < n; i++) {
+        offs[i] = pos;
+        if (kwNextRandom(&state) % 100 < KEYWORD_PERCENT) {
+            const char *w = def->keywords[kwNextRandom(&state) % def->keywordCount];
+            lens[i] = strlen(w);
+            memcpy(text + pos, w, lens[i]);
+        } else {
+            lens[i] = 1 + kwNextRandom(&state) % 12;
+            for (int j = 0; j < lens[i]; j++) {
+                int ch = "abcdefghijklmnopqrstuvwxyz_"[kwNextRandom(&state) % 27];
+                text[pos + j] = def->caseless && ch != '_' ? ch - 'a' + 'A' : ch;
+            }
+        }
+        pos += lens[i];
+        text[pos++] = '\0';   // strncmp in the old path may read one past len
+    }
+}
+
+/* Rewrite an upper-case stream as all lower case, or with every letter's
+ * case picked at random. */
+void recase(char *text, size_t len, int mixed) {
+    unsigned state = 777;
+    for (size_t i = 0; i < len; i++)
+        if (isupper((unsigned char)text[i]) && (!mixed || kwNextRandom(&state) & 1))
+            text[i] = tolower((unsigned char)text[i]);
+}
+
+void caseBench(int n, char *text, int *offs, int *lens) {
+    static const char *cases[] = { "upper", "lower", "mixed" };
+    const LanguageDef *sql = &languages[LANG_SQL];
+    KeywordTable exact, caseless;
+    if (kwBuild(&exact, sql->keywords, sql->keywordCount, 0) != 0 ||
+        kwBuild(&caseless, sql->keywords, sql->keywordCount, 1) != 0) {
+        printf("%-10s cannot build keyword tables\n", sql->name);
+        return;
+    }
+    printf("\n%-10s %14s %8s %14s %14s %8s\n",
+           "SQL case", "Exact ids/s", "Found", "Copy ids/s", "Caseless ids/s", "Found");
+    for (int c = 0; c < 3; c++) {
+        makeIdentifiers(sql, n, text, offs, lens);
+        if (c) recase(text, (size_t)offs[n - 1] + lens[n - 1], c == 2);
+
+        long hitsExact = 0, hitsCopy = 0, hitsFold = 0;
+        double t0 = now();
+        for (int i = 0; i < n; i++)
+            hitsExact += kwLookup(&exact, text + offs[i], lens[i]) >= 0;
+        double t1 = now();
+        for (int i = 0; i < n; i++)
+            hitsCopy += copyKeyword(&exact, text + offs[i], lens[i]) >= 0;
+        double t2 = now();
+        for (int i = 0; i < n; i++)
+            hitsFold += kwLookup(&caseless, text + offs[i], lens[i]) >= 0;
+        double t3 = now();
+
+        if (hitsCopy != hitsFold)
+            printf("%-10s MISMATCH: copy %ld, caseless %ld\n", cases[c], hitsCopy, hitsFold);
+        printf("%-10s %14.0f %7.1f%% %14.0f %14.0f %7.1f%%\n", cases[c],
+               n / (t1 - t0), 100.0 * hitsExact / n, n / (t2 - t1), n / (t3 - t2),
+               100.0 * hitsFold / n);
+    }
+    kwFree(&exact);
+    kwFree(&caseless);
+}
+
+int main(int argc, char **argv) {
+    int n = argc > 1 ? atoi(argv[1]) : DEFAULT_IDS;
+    if (n <= 0) { printf("usage: %s [identifiers]\n", argv[0]); return 1; }
+
+    char *text = malloc((size_t)n * 14);
+    int *offs = malloc(n * sizeof(int));
+    int *lens = malloc(n * sizeof(int));
+    if (!text || !offs || !lens) { printf("Out of memory\n"); return 1; }
+
+    printf("%-10s %6s %8s %14s %14s %8s\n",
+           "Language", "Words", "Slots", "Linear ids/s", "Hash ids/s", "Speedup");
+    for (int l = 0; l < LANG_COUNT; l++) {
+        const LanguageDef *lang = &languages[l];
+        KeywordTable kw;
+        if (kwBuild(&kw, lang->keywords, lang->keywordCount, 0) != 0) {
+            printf("%-10s cannot build keyword table\n", lang->name);
+            continue;
+        }
+        makeIdentifiers(lang, n, text, offs, lens);
+
+        long hitsLinear = 0, hitsHash = 0;
+        double t0 = now();
+        for (int i = 0; i < n; i++)
+            hitsLinear += linearKeyword(lang->keywords, lang->keywordCount, text + offs[i], lens[i]) >= 0;
+        double t1 = now();
+        for (int i = 0; i < n; i++)
+            hitsHash += kwLookup(&kw, text + offs[i], lens[i]) >= 0;
+        double t2 = now();
+
+        if (hitsLinear != hitsHash)
+            printf("%-10s MISMATCH: linear %ld, hash %ld\n", lang->name, hitsLinear, hitsHash);
+        printf("%-10s %6d %8d %14.0f %14.0f %7.1fx\n",
+               lang->name, lang->keywordCount, 1 << (32 - kw.shift),
+               n / (t1 - t0), n / (t2 - t1), (t1 - t0) / (t2 - t1));
+        kwFree(&kw);
+    }
+    caseBench(n, text, offs, lens);
+
+    free(text); free(offs); free(lens);
+    return 0;
+}
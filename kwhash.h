@@ -0,0 +1,144 @@
+#ifndef KWHASH_H
+#define KWHASH_H
+
+/* ================= KEYWORD PERFECT HASH =================
+ * A keyword list is turned into a collision-free table once at startup:
+ * the hash only looks at the length and the first, second and last bytes,
+ * and kwBuild() searches multipliers and table sizes until every keyword
+ * lands in its own slot. A lookup is then one hash, one slot load and one
+ * memcmp, and returns the keyword's index in the original list.
+ *
+ * A caseless table matches keywords in any mix of upper and lower case
+ * without copying the word: setting bit 5 of every byte lower-cases ASCII
+ * letters, so the hash folds the bytes it reads and the compare folds the
+ * word eight bytes at a time against keywords stored folded. Folding also
+ * merges some non-letters ('@' and '`', '_' and DEL), which is why such
+ * tables only take keywords made of letters: any byte folding onto a
+ * letter is that letter.
+ */
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define KW_MAX_BITS 12        /* largest table tried: 4096 slots */
+#define KW_SEED_TRIES 4096    /* multiplier sets tried per table size */
+
+typedef struct keywordTable {
+    const char **words;   // the caller's list, indexed by keyword id
+    unsigned char *lens;  // strlen of each word
+    short *slots;         // keyword id per slot, -1 if empty
+    unsigned a, b, c, d;  // hash multipliers
+    int shift;            // 32 - log2(number of slots)
+    unsigned char fold;   // 0x20 for a caseless table, else 0
+    uint64_t *folded;     // caseless: each keyword folded, padded with 0x20 to stride words
+    int stride;
+    int count;
+    int minLen, maxLen;
+} KeywordTable;
+
+static inline unsigned kwHash(const KeywordTable *kw, const char *s, int len) {
+    unsigned char c0 = s[0] | kw->fold, c1 = s[len > 1] | kw->fold, cl = s[len - 1] | kw->fold;
+    return (len * kw->a + c0 * kw->b + c1 * kw->c + cl * kw->d) >> kw->shift;
+}
+
+#define KW_FOLD8 0x2020202020202020ull
+
+/* Whether len bytes at s are keyword id up to ASCII case. */
+static inline int kwEqualFold(const KeywordTable *kw, int id, const char *s, int len) {
+    const uint64_t *w = kw->folded + (size_t)id * kw->stride;
+    uint64_t x;
+    for (; len >= 8; s += 8, len -= 8, w++) {
+        memcpy(&x, s, 8);
+        if ((x | KW_FOLD8) != *w) return 0;
+    }
+    x = 0;
+    memcpy(&x, s, len);
+    return (x | KW_FOLD8) == *w;
+}
+
+/* Returns the keyword id of s, or -1 if it is not a keyword. */
+static inline int kwLookup(const KeywordTable *kw, const char *s, int len) {
+    if (len < kw->minLen || len > kw->maxLen) return -1;
+    int id = kw->slots[kwHash(kw, s, len)];
+    if (id < 0 || kw->lens[id] != len)
+        return -1;
+    if (kw->fold ? !kwEqualFold(kw, id, s, len) : memcmp(kw->words[id], s, len) != 0)
+        return -1;
+    return id;
+}
+
+static unsigned kwNextRandom(unsigned *state) {
+    unsigned x = *state;
+    x ^= x << 13; x ^= x >> 17; x ^= x << 5;
+    return *state = x;
+}
+
+/* Returns 0 on success, -1 if no collision-free table was found or a
+ * caseless table is given a keyword that is not all letters. */
+static int kwBuild(KeywordTable *kw, const char **words, int count, int caseless) {
+    memset(kw, 0, sizeof(*kw));
+    kw->words = words;
+    kw->count = count;
+    kw->fold = caseless ? 0x20 : 0;
+    kw->lens = malloc(count);
+    kw->minLen = 255;
+    for (int i = 0; i < count; i++) {
+        kw->lens[i] = strlen(words[i]);
+        for (int j = 0; caseless && j < kw->lens[i]; j++)
+            if ((words[i][j] | 0x20) < 'a' || (words[i][j] | 0x20) > 'z') {
+                free(kw->lens);
+                kw->lens = NULL;
+                return -1;
+            }
+        if (kw->lens[i] < kw->minLen) kw->minLen = kw->lens[i];
+        if (kw->lens[i] > kw->maxLen) kw->maxLen = kw->lens[i];
+    }
+
+    if (caseless) {
+        kw->stride = kw->maxLen / 8 + 1;
+        kw->folded = calloc((size_t)count * kw->stride, sizeof(uint64_t));
+        for (int i = 0; i < count; i++) {
+            unsigned char *w = (unsigned char *)(kw->folded + (size_t)i * kw->stride);
+            memcpy(w, words[i], kw->lens[i]);
+            for (int j = 0; j < kw->stride * 8; j++) w[j] |= 0x20;
+        }
+    }
+
+    int bits = 1;
+    while ((1 << bits) < count) bits++;
+    unsigned state = 0x9E3779B9u;
+    for (; bits <= KW_MAX_BITS; bits++) {
+        int size = 1 << bits;
+        short *slots = malloc(size * sizeof(short));
+        kw->shift = 32 - bits;
+        for (int tries = 0; tries < KW_SEED_TRIES; tries++) {
+            kw->a = kwNextRandom(&state) | 1;
+            kw->b = kwNextRandom(&state) | 1;
+            kw->c = kwNextRandom(&state) | 1;
+            kw->d = kwNextRandom(&state) | 1;
+            memset(slots, 0xff, size * sizeof(short));
+            int i;
+            for (i = 0; i < count; i++) {
+                unsigned h = kwHash(kw, words[i], kw->lens[i]);
+                if (slots[h] >= 0) break;
+                slots[h] = i;
+            }
+            if (i == count) { kw->slots = slots; return 0; }
+        }
+        free(slots);
+    }
+    free(kw->lens);
+    free(kw->folded);
+    kw->lens = NULL;
+    kw->folded = NULL;
+    return -1;
+}
+
+static void kwFree(KeywordTable *kw) {
+    free(kw->slots);
+    free(kw->lens);
+    free(kw->folded);
+    memset(kw, 0, sizeof(*kw));
+}
+
+#endif
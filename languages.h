@@ -0,0 +1,159 @@
+#ifndef LANGUAGES_H
+#define LANGUAGES_H
+
+/* ================= LANGUAGE DESCRIPTORS =================
+ * Everything the lexer engine knows about a language. lexer_open() compiles
+ * a descriptor into a byte class table and a punctuation DFA, so adding a
+ * language means adding an entry here, not writing a scanner.
+ */
+#include <string.h>
+
+typedef enum language {
+    LANG_C,              // symbol.c
+    LANG_C_SCOPED,       // symbol2.c: C with nested scopes
+    LANG_SQL,
+    LANG_RUST,
+    LANG_JAVA,
+    LANG_PYTHON,
+    LANG_COUNT
+} Language;
+
+/* Numeric literal syntax, or'ed into LanguageDef.numbers. */
+enum {
+    NUM_FRACTION = 1,       // "1.5", and "1." unless a name or another '.' follows
+    NUM_EXPONENT = 2,       // "1e9", "2.5E-3"
+    NUM_HEX = 4,            // "0xFF"
+    NUM_OCTAL = 8,          // "0o17"
+    NUM_BINARY = 16,        // "0b101"
+    NUM_LEADING_ZERO = 32,  // "017" is octal
+    NUM_UNDERSCORE = 64     // '_' between digits: "1_000"
+};
+
+typedef struct languageDef {
+    const char *name;
+    const char *extension;     // file name suffix picking this language, if any
+    const char **keywords;
+    int keywordCount;
+    int caseless;              // keywords match in any case; the token keeps the spelling
+    const char *operators;     // single character operators
+    const char *pairs;         // two character operators, back to back
+    int opEquals;              // any operator followed by '=' is one token
+    const char *delimiters;
+    const char *quotes;        // each opens a TOK_STRING closed by the same byte
+    int escapes;               // a quote after an odd run of '\\' does not close its string
+    const char *charQuotes;    // likewise for TOK_CHAR
+    const char *lineComment;   // runs to the end of the line
+    const char *blockOpen, *blockClose;
+    int tripleQuotes;          // '''...''' and """...""" strings; TOK_DOCSTRING if they start a logical line
+    const char *preproc;       // emitted as TOK_PREPROC; the rest of its line is skipped
+    int numbers;               // numeric literal syntax beyond decimal integers, NUM_*
+    const char *numberSuffixes;  // space separated; f, d and j ones make a float
+    int calls;                 // an identifier followed by '(' is a TOK_FUNC ...
+    const char *callAfter;     // ... but only straight after this keyword
+    int scoped;                // functions and { } nest scopes for the identifiers inside
+    int layout;                // a TOK_NEWLINE ends each line not inside ( [ { or ended by '\\'
+    int skipUnknown;           // bytes no rule matches are dropped, not TOK_INVALID
+} LanguageDef;
+
+static const char *cKeywords[] = {
+    "int","float","char","double","if","else",
+    "while","for","return","void","break","continue"
+};
+static const char *cScopedKeywords[] = {
+    "int","float","char","double","void","if","else","while","for","return","const"
+};
+static const char *sqlKeywords[] = {
+    "SELECT","FROM","WHERE","INSERT","INTO","VALUES","UPDATE","SET","DELETE",
+    "CREATE","TABLE","DROP","ALTER","JOIN","INNER","LEFT","RIGHT","FULL",
+    "ON","AS","DISTINCT","AND","OR","NOT","LIKE","IN","GROUP","BY","ORDER","HAVING"
+};
+static const char *rustKeywords[] = {
+    "fn","let","mut","const","static","if","else","match","loop","while","for",
+    "return","struct","enum","impl","trait","pub","use","mod","crate","as",
+    "in","ref","break","continue","async","await"
+};
+static const char *javaKeywords[] = {
+    "int","float","double","char","boolean","void",
+    "if","else","for","while","do","return","break","continue",
+    "public","private","protected","class","static","final","abstract",
+    "interface","extends","implements","try","catch","throw","throws",
+    "new","package","import","this","super","switch","case","default",
+    "enum","instanceof","synchronized"
+};
+static const char *pythonKeywords[] = {
+    "def","import","for","in","if","else","elif","while",
+    "return","break","continue","class","with","as","pass","global","nonlocal"
+};
+
+#define C_NUMBER_SUFFIXES "u U l L ul UL lu LU ll LL ull ULL llu LLU f F"
+#define KEYWORDS(w) .keywords = w, .keywordCount = sizeof(w) / sizeof(w[0])
+static const LanguageDef languages[LANG_COUNT] = {
+    [LANG_C] = {
+        .name = "c", .extension = ".c", KEYWORDS(cKeywords),
+        .operators = "+-*/=<>!&|%", .pairs = "++--&&||", .opEquals = 1,
+        .delimiters = "(){}[];,.", .quotes = "\"", .charQuotes = "'",
+        .lineComment = "//", .blockOpen = "/*", .blockClose = "*/",
+        .preproc = "#", .calls = 1,
+        .numbers = NUM_FRACTION | NUM_EXPONENT | NUM_HEX | NUM_BINARY | NUM_LEADING_ZERO,
+        .numberSuffixes = C_NUMBER_SUFFIXES,
+    },
+    [LANG_C_SCOPED] = {
+        .name = "c-scoped", KEYWORDS(cScopedKeywords),
+        .operators = "+-*/%=!<>|&", .pairs = "==!=<=>=&&||++--",
+        .delimiters = "(){}[];,", .quotes = "\"",
+        .lineComment = "//", .blockOpen = "/*", .blockClose = "*/",
+        .calls = 1, .scoped = 1, .skipUnknown = 1,
+        .numbers = NUM_FRACTION | NUM_EXPONENT | NUM_HEX | NUM_BINARY | NUM_LEADING_ZERO,
+        .numberSuffixes = C_NUMBER_SUFFIXES,
+    },
+    [LANG_SQL] = {
+        .name = "sql", .extension = ".sql", KEYWORDS(sqlKeywords), .caseless = 1,
+        .operators = "+-*/%=<>!", .pairs = "<>", .opEquals = 1,
+        .delimiters = "(),;", .quotes = "'",
+        .lineComment = "--", .blockOpen = "/*", .blockClose = "*/",
+        .numbers = NUM_FRACTION | NUM_EXPONENT,
+    },
+    [LANG_RUST] = {
+        .name = "rust", .extension = ".rs", KEYWORDS(rustKeywords),
+        .operators = "+-*/%=<>!&|^", .pairs = "&&||", .opEquals = 1,
+        .delimiters = "(){}[],;:.", .quotes = "\"'",
+        .lineComment = "//", .blockOpen = "/*", .blockClose = "*/",
+        .calls = 1,
+        .numbers = NUM_FRACTION | NUM_EXPONENT | NUM_HEX | NUM_OCTAL | NUM_BINARY | NUM_UNDERSCORE,
+        .numberSuffixes = "i8 i16 i32 i64 i128 isize u8 u16 u32 u64 u128 usize f32 f64",
+    },
+    [LANG_JAVA] = {
+        .name = "java", .extension = ".java", KEYWORDS(javaKeywords),
+        .operators = "+-*/%=<>!&|^", .pairs = "&&||++--", .opEquals = 1,
+        .delimiters = "(){}[],;:.", .quotes = "\"'",
+        .lineComment = "//", .blockOpen = "/*", .blockClose = "*/",
+        .calls = 1,
+        .numbers = NUM_FRACTION | NUM_EXPONENT | NUM_HEX | NUM_BINARY | NUM_LEADING_ZERO |
+                   NUM_UNDERSCORE,
+        .numberSuffixes = "l L f F d D",
+    },
+    [LANG_PYTHON] = {
+        .name = "python", .extension = ".py", KEYWORDS(pythonKeywords),
+        .operators = "+-*/%=!<>|&", .pairs = "++--", .opEquals = 1,
+        .delimiters = "():,[]{}", .quotes = "\"'", .escapes = 1,
+        .lineComment = "#", .tripleQuotes = 1, .layout = 1,
+        .calls = 1, .callAfter = "def",
+        .numbers = NUM_FRACTION | NUM_EXPONENT | NUM_HEX | NUM_OCTAL | NUM_BINARY | NUM_UNDERSCORE,
+        .numberSuffixes = "j J",
+    },
+};
+#undef KEYWORDS
+#undef C_NUMBER_SUFFIXES
+
+/* Language whose extension ends path, or -1. */
+static inline int languageForPath(const char *path) {
+    size_t n = strlen(path);
+    for (int i = 0; i < LANG_COUNT; i++) {
+        const char *ext = languages[i].extension;
+        size_t e = ext ? strlen(ext) : 0;
+        if (e && n > e && strcmp(path + n - e, ext) == 0) return i;
+    }
+    return -1;
+}
+
+#endif
@@ -0,0 +1,310 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <dirent.h>
+#include <sys/stat.h>
+#include <time.h>
+#include "lexer.h"
+#include "workpool.h"
+#include "tokcache.h"
+#include "indent.h"
+
+/* Lex whole trees at once. Every path given is a file or a directory to
+ * walk (hidden entries skipped); "-" reads more paths from stdin, one per
+ * line. The language comes from the file extension. Files are lexed in
+ * parallel, largest first, but their reports are printed in the order the
+ * files were named and found, so the output does not depend on the
+ * schedule. Throughput goes to stderr.
+ *
+ *   cc -O2 -pthread lexall.c -o lexall
+ *   ./lexall [-j threads] [-t] [-c cachedir [-m megabytes]] path...
+ *
+ * -t prints each file's tokens, as <KIND,text,line,col>, instead of a
+ * one line summary. A layout language's INDENT and DEDENT tokens
+ * (indent.h) are counted, cached and printed with the others.
+ *
+ * -c keeps every file's tokens and symbols in cachedir (tokcache.h), and
+ * files whose content, language and lexer are unchanged since they were
+ * cached are replayed from there instead of lexed. After the run the
+ * cache is trimmed to -m megabytes (256 by default, 0 for no limit),
+ * least recently used entries first, and its hit rate goes to stderr.
+ */
+
+typedef struct job {
+    char *path;
+    int lang;
+    size_t size;
+    char *out;              // this file's report, printed in job order
+    size_t outLen;
+    uint64_t tokens;
+    uint32_t symbols;
+    int failed;
+    int done;
+} Job;
+
+Job *jobs = NULL;
+int jobCount = 0, jobCap = 0;
+int dumpTokens = 0;
+int missing = 0;            // named paths that could not be read
+TokenCache cache;
+int caching = 0;
+
+Lexer *lexers;              // workers x LANG_COUNT, each opened on first use
+char *lexerReady;
+
+pthread_mutex_t printLock = PTHREAD_MUTEX_INITIALIZER;
+int nextPrint = 0;
+
+/* ---------------- FILE LIST ---------------- */
+void addJob(const char *path, int lang, size_t size) {
+    if (jobCount == jobCap) {
+        jobCap = jobCap ? jobCap * 2 : 256;
+        jobs = realloc(jobs, jobCap * sizeof(Job));
+    }
+    Job *j = &jobs[jobCount++];
+    memset(j, 0, sizeof(*j));
+    j->path = strdup(path);
+    j->lang = lang;
+    j->size = size;
+}
+
+int compareNames(const void *a, const void *b) {
+    return strcmp(*(char *const *)a, *(char *const *)b);
+}
+
+void addPath(const char *path, int named);
+
+/* Entries in name order, so runs over the same tree list files alike. */
+void walkDir(const char *dir) {
+    DIR *d = opendir(dir);
+    if (!d) { fprintf(stderr, "lexall: cannot read %s\n", dir); missing++; return; }
+    char **names = NULL;
+    int n = 0, cap = 0;
+    struct dirent *e;
+    while ((e = readdir(d)) != NULL) {
+        if (e->d_name[0] == '.') continue;
+        if (n == cap) {
+            cap = cap ? cap * 2 : 64;
+            names = realloc(names, cap * sizeof(char *));
+        }
+        names[n++] = strdup(e->d_name);
+    }
+    closedir(d);
+    qsort(names, n, sizeof(char *), compareNames);
+
+    for (int i = 0; i < n; i++) {
+        size_t len = strlen(dir) + strlen(names[i]) + 2;
+        char *child = malloc(len);
+        snprintf(child, len, "%s/%s", dir, names[i]);
+        addPath(child, 0);
+        free(child);
+        free(names[i]);
+    }
+    free(names);
+}
+
+/* named: given by the user, so an unknown extension is worth a warning. */
+void addPath(const char *path, int named) {
+    struct stat st;
+    if (stat(path, &st) != 0) {
+        fprintf(stderr, "lexall: cannot open %s\n", path);
+        missing++;
+        return;
+    }
+    if (S_ISDIR(st.st_mode)) { walkDir(path); return; }
+    if (!S_ISREG(st.st_mode)) return;
+    int lang = languageForPath(path);
+    if (lang < 0) {
+        if (named) fprintf(stderr, "lexall: skipping %s: unknown extension\n", path);
+        return;
+    }
+    addJob(path, lang, st.st_size);
+}
+
+void addPathsFrom(FILE *fp) {
+    char line[4096];
+    while (fgets(line, sizeof(line), fp)) {
+        line[strcspn(line, "\r\n")] = '\0';
+        if (line[0]) addPath(line, 1);
+    }
+}
+
+/* ---------------- LEXING ---------------- */
+
+/* Print every finished report at the head of the list. */
+void publish(Job *job) {
+    pthread_mutex_lock(&printLock);
+    job->done = 1;
+    while (nextPrint < jobCount && jobs[nextPrint].done) {
+        Job *j = &jobs[nextPrint++];
+        fwrite(j->out, 1, j->outLen, stdout);
+        free(j->out);
+        j->out = NULL;
+    }
+    pthread_mutex_unlock(&printLock);
+}
+
+void keepToken(Job *job, FILE *out, CacheStore *st, const Token *t) {
+    job->tokens++;
+    if (st) twAppend(&st->w, t->kind, t->text, t->row, t->col);
+    if (dumpTokens)
+        fprintf(out, "<%s,%.*s,%d,%d>\n", tokenKindNames[t->kind],
+                t->text.len, t->text.ptr, t->row, t->col);
+}
+
+/* Lex src, storing the results in the cache when there is one. */
+void lexSource(Job *job, FILE *out, Lexer *lx, const Source *src, const char *key) {
+    Token t, d;
+    IndentStack is;
+    int layout = lx->def->layout;
+    CacheStore *st = caching ? malloc(sizeof(CacheStore)) : NULL;
+    if (st && tcStoreBegin(&cache, st, key, src->data) != 0) { free(st); st = NULL; }
+    lexer_reset(lx, src->data, src->len);
+    indentOpen(&is, lx);
+    while (lexer_next(lx, &t)) {
+        while (layout && indentNext(&is, &t, &d)) keepToken(job, out, st, &d);
+        keepToken(job, out, st, &t);
+    }
+    while (layout && indentNext(&is, &t, &d)) keepToken(job, out, st, &d);
+    job->symbols = lx->symbolCount;
+    if (st) tcStoreEnd(&cache, st, lx);
+    free(st);
+}
+
+/* Replay a cache hit; returns -1 if the entry does not fit src. */
+int replay(Job *job, FILE *out, const Source *src, const TokenFile *tokens, const SymSnapshot *symbols) {
+    job->tokens = tokens->count;
+    job->symbols = symbols->symbolCount;
+    if (!dumpTokens) return 0;
+    TokenCursor c;
+    TokenRecord t;
+    int rc;
+    tfBegin(tokens, &c);
+    while ((rc = tfNext(&c, &t)) > 0) {
+        if (t.kind >= TOK_KIND_COUNT || t.offset > src->len || t.length > src->len - t.offset)
+            return -1;
+        fprintf(out, "<%s,%.*s,%u,%u>\n", tokenKindNames[t.kind],
+                (int)t.length, src->data + t.offset, t.line, t.column);
+    }
+    return rc;
+}
+
+void lexFile(void *arg, int worker) {
+    Job *job = arg;
+    FILE *out = open_memstream(&job->out, &job->outLen);
+    Lexer *lx = &lexers[worker * LANG_COUNT + job->lang];
+    char *ready = &lexerReady[worker * LANG_COUNT + job->lang];
+    Source src;
+
+    if (!*ready && lexer_open(lx, NULL, 0, job->lang) == 0) *ready = 1;
+    if (!*ready) {
+        fprintf(out, "%s: cannot build %s tables\n", job->path, languages[job->lang].name);
+        job->failed = 1;
+    } else if (srcOpen(&src, job->path) != 0) {
+        fprintf(out, "%s: cannot open\n", job->path);
+        job->failed = 1;
+    } else {
+        char key[TC_KEY];
+        TokenFile tokens;
+        SymSnapshot symbols;
+        if (dumpTokens) fprintf(out, "== %s\n", job->path);
+        if (caching) tcKey(key, src.data, src.len, job->lang);
+        if (caching && tcLookup(&cache, key, &tokens, &symbols)) {
+            if (replay(job, out, &src, &tokens, &symbols) != 0) {
+                fprintf(out, "%s: corrupt cache entry %s\n", job->path, key);
+                job->failed = 1;
+            }
+            tfClose(&tokens);
+            snapClose(&symbols);
+        } else {
+            lexSource(job, out, lx, &src, key);
+        }
+        if (!dumpTokens && !job->failed)
+            fprintf(out, "%s\t%s\t%zu bytes\t%llu tokens\t%u symbols\n", job->path,
+                    languages[job->lang].name, job->size,
+                    (unsigned long long)job->tokens, job->symbols);
+        srcClose(&src);
+    }
+    fclose(out);
+    publish(job);
+}
+
+/* Largest first: the big files start early instead of finishing last. */
+int compareSizes(const void *a, const void *b) {
+    const Job *x = *(Job *const *)a, *y = *(Job *const *)b;
+    return (x->size < y->size) - (x->size > y->size);
+}
+
+double now() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+/* ---------------- MAIN ---------------- */
+int main(int argc, char **argv) {
+    int threads = 0, paths = 0;
+    const char *cacheDir = NULL;
+    uint64_t cacheLimit = 256;
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "-j") == 0 && i + 1 < argc) threads = atoi(argv[++i]);
+        else if (strcmp(argv[i], "-t") == 0) dumpTokens = 1;
+        else if (strcmp(argv[i], "-c") == 0 && i + 1 < argc) cacheDir = argv[++i];
+        else if (strcmp(argv[i], "-m") == 0 && i + 1 < argc) cacheLimit = strtoull(argv[++i], NULL, 10);
+        else if (strcmp(argv[i], "-") == 0) { addPathsFrom(stdin); paths++; }
+        else if (argv[i][0] == '-') { paths = 0; break; }
+        else { addPath(argv[i], 1); paths++; }
+    }
+    if (!paths) {
+        printf("usage: %s [-j threads] [-t] [-c cachedir [-m megabytes]] path...\n", argv[0]);
+        return 1;
+    }
+    if (cacheDir) {
+        if (tcOpen(&cache, cacheDir, cacheLimit * 1000000) != 0) {
+            printf("Cannot use %s as a cache\n", cacheDir);
+            return 1;
+        }
+        caching = 1;
+    }
+
+    double start = now();
+    WorkPool wp;
+    if (wpStart(&wp, threads) != 0) { printf("Cannot start worker threads\n"); return 1; }
+    lexers = calloc((size_t)wp.workers * LANG_COUNT, sizeof(Lexer));
+    lexerReady = calloc((size_t)wp.workers * LANG_COUNT, 1);
+
+    Job **order = malloc((jobCount + 1) * sizeof(Job *));
+    for (int i = 0; i < jobCount; i++) order[i] = &jobs[i];
+    qsort(order, jobCount, sizeof(Job *), compareSizes);
+    for (int i = 0; i < jobCount; i++)
+        wpSubmit(&wp, i, lexFile, order[i]);
+    wpWait(&wp);
+    int workers = wp.workers;
+    wpStop(&wp);
+    double elapsed = now() - start;
+
+    uint64_t bytes = 0, tokens = 0;
+    int failed = missing;
+    for (int i = 0; i < jobCount; i++) {
+        bytes += jobs[i].size;
+        tokens += jobs[i].tokens;
+        failed += jobs[i].failed;
+        free(jobs[i].path);
+    }
+    fprintf(stderr, "lexall: %d files, %.1f MB, %llu tokens in %.3f s on %d threads"
+            " (%.1f MB/s, %.2f Mtokens/s)\n",
+            jobCount, bytes / 1e6, (unsigned long long)tokens, elapsed, workers,
+            elapsed > 0 ? bytes / 1e6 / elapsed : 0, elapsed > 0 ? tokens / 1e6 / elapsed : 0);
+    if (caching) {
+        tcTrim(&cache);
+        tcReport(&cache, stderr);
+    }
+
+    for (int i = 0; i < workers * LANG_COUNT; i++)
+        if (lexerReady[i]) lexer_close(&lexers[i]);
+    free(lexerReady);
+    free(lexers);
+    free(order);
+    free(jobs);
+    return failed ? 1 : 0;
+}
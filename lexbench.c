@@ -0,0 +1,482 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdarg.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/resource.h>
+#include <sys/wait.h>
+#include "lexer.h"
+#include "lexstream.h"
+
+/* Lexer throughput suite. For every language and corpus mix it generates a
+ * synthetic corpus (the same bytes on every run and machine), lexes it and
+ * reports MB/s, tokens/s, ns/token, peak RSS and symbol table insert and
+ * lookup rates. Each case runs in its own process so its peak RSS is its
+ * own. It is also streamed (lexstream.h) through a window of CHECK_WINDOW
+ * bytes, and fails if that gives other tokens or the window grows: no
+ * corpus has a token or comment that long, so streaming must run in flat
+ * memory, on the trivia mix (comments and blank lines only) too.
+ *
+ *   cc -O2 lexbench.c -o lexbench
+ *   ./lexbench [-s MB] [-r reps] [-l lang] [-m mix] [-w dir]
+ *              [-o results.json] [-b baseline.json] [-t percent]
+ *
+ * Every figure is the best of at least -r runs (default 5) that together
+ * take at least MIN_SECONDS. -o writes the results as JSON; -b compares
+ * them against an earlier -o file and exits 1 if a rate fell, or peak RSS
+ * grew, by more than -t percent (default 10). -w also writes each corpus
+ * to dir.
+ */
+
+#define DEFAULT_MB 4
+#define DEFAULT_REPS 5
+#define MIN_SECONDS 0.25           // keep repeating a measurement at least this long
+#define DEFAULT_THRESHOLD 10.0
+#define MAX_DEPTH 32
+#define CHECK_WINDOW (64 * 1024)
+
+/* ---------------- CORPORA ---------------- */
+typedef enum mix {
+    MIX_MIXED, MIX_COMMENTS, MIX_IDENTIFIERS, MIX_LITERALS, MIX_SCOPES, MIX_TRIVIA, MIX_COUNT
+} Mix;
+const char *mixNames[MIX_COUNT] = { "mixed", "comments", "identifiers", "literals", "scopes", "trivia" };
+
+typedef enum line { L_ASSIGN, L_NUMBERS, L_TEXT, L_COMMENT, L_BLOCK, L_OPEN, L_CLOSE, L_BLANK, L_COUNT } Line;
+
+/* Percent of lines of each kind, per mix. */
+const int lineWeights[MIX_COUNT][L_COUNT] = {
+    [MIX_MIXED]       = { [L_ASSIGN] = 40, [L_NUMBERS] = 10, [L_TEXT] = 10, [L_COMMENT] = 10,
+                          [L_BLOCK] = 5, [L_OPEN] = 10, [L_CLOSE] = 10, [L_BLANK] = 5 },
+    [MIX_COMMENTS]    = { [L_ASSIGN] = 15, [L_COMMENT] = 40, [L_BLOCK] = 35, [L_BLANK] = 10 },
+    [MIX_IDENTIFIERS] = { [L_ASSIGN] = 90, [L_OPEN] = 5, [L_CLOSE] = 5 },
+    [MIX_LITERALS]    = { [L_ASSIGN] = 10, [L_NUMBERS] = 45, [L_TEXT] = 45 },
+    [MIX_SCOPES]      = { [L_ASSIGN] = 35, [L_OPEN] = 35, [L_CLOSE] = 30 },
+    [MIX_TRIVIA]      = { [L_COMMENT] = 60, [L_BLOCK] = 30, [L_BLANK] = 10 },
+};
+
+/* Statement shapes per language. assign: four names and a number; numbers:
+ * a name and five numbers; text: a name and a string body; open: a scope
+ * name and a parameter. */
+typedef struct flavor {
+    const char *assign, *numbers, *text, *open, *close;
+} Flavor;
+
+const Flavor flavors[LANG_COUNT] = {
+    [LANG_C] = { "%s = %s + %s(%s, %u);", "%s = %u + %u * 0x%x - %u.%u;", "%s = \"%s\";",
+                 "int %s(int %s) {", "}" },
+    [LANG_C_SCOPED] = { "%s = %s + %s(%s, %u);", "%s = %u + %u * %u - %u / %u;", "%s = \"%s\";",
+                        "int %s(int %s) {", "}" },
+    [LANG_SQL] = { "SELECT %s, %s FROM %s WHERE %s = %u;", "UPDATE %s SET v = %u + %u * %u WHERE id = %u.%u;",
+                   "INSERT INTO %s VALUES ('%s');", "CREATE TABLE %s (%s INT,", ");" },
+    [LANG_RUST] = { "let %s = %s + %s(%s, %u);", "let %s = %u + %u * 0x%x - %u.%u;", "let %s = \"%s\";",
+                    "fn %s(%s: i32) -> i32 {", "}" },
+    [LANG_JAVA] = { "%s = %s + %s(%s, %u);", "%s = %u + %u * 0x%x - %u.%u;", "String %s = \"%s\";",
+                    "static int %s(int %s) {", "}" },
+    [LANG_PYTHON] = { "%s = %s + %s(%s, %u)", "%s = %u + %u * 0x%x - %u.%u", "%s = \"%s\"",
+                      "def %s(%s):", "" },
+};
+
+const char *namePrefixes[] = {
+    "count", "index", "buffer", "value", "node", "total", "next", "result", "tmp", "state"
+};
+const char *words[] = {
+    "the", "lexer", "reads", "each", "byte", "once", "and", "keeps", "a", "table",
+    "of", "names", "seen", "so", "far", "without", "copying", "them", "twice", "here"
+};
+
+typedef struct corpus {
+    char *data;
+    size_t len, cap;
+    unsigned seed;
+    int vocabulary;        // distinct identifier names
+    int depth;             // open scopes
+    unsigned scopes;       // scopes opened so far, for unique names
+    char names[4][64];     // ring of name buffers for one line
+    int nextName;
+    char sentence[256];
+} Corpus;
+
+unsigned rnd(Corpus *c) {
+    c->seed ^= c->seed << 13;
+    c->seed ^= c->seed >> 17;
+    c->seed ^= c->seed << 5;
+    return c->seed;
+}
+
+void put(Corpus *c, const char *fmt, ...) {
+    va_list ap;
+    for (;;) {
+        va_start(ap, fmt);
+        int n = vsnprintf(c->data + c->len, c->cap - c->len, fmt, ap);
+        va_end(ap);
+        if (c->len + n < c->cap) { c->len += n; return; }
+        c->cap = c->cap * 2 + n + 1;
+        c->data = realloc(c->data, c->cap);
+    }
+}
+
+/* Name number id; every eighth one is long enough for the vector path. */
+const char *name(Corpus *c, unsigned id) {
+    char *buf = c->names[c->nextName++ & 3];
+    snprintf(buf, sizeof(c->names[0]), "%s%u%s", namePrefixes[id % 10], id / 10,
+             id % 8 == 0 ? "_with_a_longer_name" : "");
+    return buf;
+}
+
+const char *someName(Corpus *c) {
+    return name(c, rnd(c) % c->vocabulary);
+}
+
+/* n words of prose, for comments and string bodies. */
+const char *prose(Corpus *c, int n) {
+    size_t len = 0;
+    for (int i = 0; i < n; i++)
+        len += snprintf(c->sentence + len, sizeof(c->sentence) - len, i ? " %s" : "%s",
+                        words[rnd(c) % 20]);
+    return c->sentence;
+}
+
+void generate(Corpus *c, Language lang, Mix mix, size_t size) {
+    const LanguageDef *def = &languages[lang];
+    const Flavor *f = &flavors[lang];
+    memset(c, 0, sizeof(*c));
+    c->seed = 0x9E3779B9u ^ (lang * 977 + mix * 131 + 1);
+    c->vocabulary = mix == MIX_IDENTIFIERS ? 50000 : 2000;
+    c->cap = size + 4096;
+    c->data = malloc(c->cap);
+
+    while (c->len < size) {
+        int pick = rnd(c) % 100, line = 0;
+        while (pick >= lineWeights[mix][line]) pick -= lineWeights[mix][line++];
+        if ((line == L_OPEN && c->depth == MAX_DEPTH) || (line == L_CLOSE && c->depth == 0))
+            line = L_ASSIGN;
+        if (line == L_CLOSE && (c->depth--, !*f->close))
+            continue;   // closed by the indentation of the next line
+        for (int i = 0; i < c->depth; i++) put(c, "    ");
+
+        switch (line) {
+        case L_ASSIGN:
+            put(c, f->assign, someName(c), someName(c), someName(c), someName(c), rnd(c) % 1000);
+            break;
+        case L_NUMBERS:
+            put(c, f->numbers, someName(c), rnd(c) % 100000, rnd(c) % 1000, rnd(c) % 65536,
+                rnd(c) % 100, rnd(c) % 1000);
+            break;
+        case L_TEXT:
+            put(c, f->text, someName(c), prose(c, 3 + rnd(c) % 8));
+            break;
+        case L_COMMENT:
+            put(c, "%s %s", def->lineComment, prose(c, 8));
+            break;
+        case L_BLOCK:
+            put(c, "%s ", def->blockOpen ? def->blockOpen : "\"\"\"");
+            for (int i = 0; i < 3; i++)
+                put(c, "%s\n", prose(c, 10));
+            put(c, "%s", def->blockOpen ? def->blockClose : "\"\"\"");
+            break;
+        case L_OPEN:
+            put(c, f->open, name(c, c->vocabulary + c->scopes++), someName(c));
+            c->depth++;
+            break;
+        case L_CLOSE:
+            put(c, "%s", f->close);
+            break;
+        }
+        put(c, "\n");
+    }
+}
+
+/* ---------------- MEASURING ---------------- */
+typedef struct result {
+    int lang, mix;
+    size_t bytes;
+    uint64_t tokens;
+    double seconds;            // best lex of the whole corpus
+    long peakRssKb;
+    uint32_t symbols;
+    double insertsPerSec, lookupsPerSec;
+    size_t window;             // streaming window after the corpus, started at CHECK_WINDOW
+    int failed;
+} Result;
+
+double now() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+void measure(Result *r, int reps, const char *dir) {
+    Corpus c;
+    Lexer lx;
+    Token t;
+    generate(&c, r->lang, r->mix, r->bytes);
+    r->bytes = c.len;
+    if (dir) {
+        char path[4096];
+        const char *ext = languages[r->lang].extension;
+        snprintf(path, sizeof(path), "%s/%s-%s%s", dir, languages[r->lang].name,
+                 mixNames[r->mix], ext ? ext : ".c");
+        FILE *fp = fopen(path, "wb");
+        if (fp) { fwrite(c.data, 1, c.len, fp); fclose(fp); }
+    }
+    if (lexer_open(&lx, NULL, 0, r->lang) != 0) { r->failed = 1; return; }
+
+    /* Whole lexer, symbols included. */
+    r->seconds = 1e30;
+    double start = now();
+    for (int i = 0; i < reps || now() - start < MIN_SECONDS; i++) {
+        lexer_reset(&lx, c.data, c.len);
+        uint64_t n = 0;
+        double t0 = now();
+        while (lexer_next(&lx, &t)) n++;
+        double s = now() - t0;
+        if (s < r->seconds) r->seconds = s;
+        r->tokens = n;
+    }
+    r->symbols = lx.symbolCount;
+
+    /* Symbol table alone, on the identifier and function tokens: first
+     * sightings into an empty table, then every token against the full one. */
+    Token *names = NULL;
+    uint32_t *scopes = NULL;
+    char *first = NULL;
+    size_t count = 0, cap = 0, inserts = 0;
+    lexer_reset(&lx, c.data, c.len);
+    lx.deferSymbols = 1;
+    while (lexer_next(&lx, &t)) {
+        if (t.kind != TOK_IDENTIFIER && t.kind != TOK_FUNC) continue;
+        if (count == cap) {
+            cap = cap ? cap * 2 : 4096;
+            names = realloc(names, cap * sizeof(Token));
+            scopes = realloc(scopes, cap * sizeof(uint32_t));
+            first = realloc(first, cap);
+        }
+        uint32_t before = lx.symbolCount;
+        scopes[count] = t.kind == TOK_FUNC ? lx.globalScope : lx.scope;
+        names[count] = t;
+        lexRecord(&lx, &t);
+        first[count] = lx.symbolCount > before;
+        inserts += first[count++];
+    }
+    double insert = 1e30, lookup = 1e30;
+    start = now();
+    for (int i = 0; count && (i < reps || now() - start < 2 * MIN_SECONDS); i++) {
+        lexer_reset(&lx, c.data, c.len);    // names come back with the same ids
+        double t0 = now();
+        for (size_t k = 0; k < count; k++)
+            if (first[k])
+                lexAddSymbol(&lx, names[k].text, scopes[k],
+                             names[k].kind == TOK_FUNC ? SYM_FUNC : SYM_IDENTIFIER);
+        double s = now() - t0;
+        if (s < insert) insert = s;
+        t0 = now();
+        for (size_t k = 0; k < count; k++)
+            lexAddSymbol(&lx, names[k].text, scopes[k], SYM_IDENTIFIER);
+        s = now() - t0;
+        if (s < lookup) lookup = s;
+    }
+    r->insertsPerSec = count && insert > 0 ? inserts / insert : 0;
+    r->lookupsPerSec = count && lookup > 0 ? count / lookup : 0;
+
+    /* Streamed from a file: the same tokens, in a window that never grows. */
+    FILE *fp = tmpfile();
+    LexStream ls;
+    uint64_t streamed = 0;
+    if (!fp || fwrite(c.data, 1, c.len, fp) != c.len || fflush(fp) != 0 ||
+        lseek(fileno(fp), 0, SEEK_SET) != 0 || streamOpen(&ls, &lx, fileno(fp), CHECK_WINDOW) != 0) {
+        r->failed = 1;
+    } else {
+        while (streamNext(&ls, &t)) streamed++;
+        r->window = ls.cap;
+        if (ls.error || streamed != r->tokens || ls.cap != CHECK_WINDOW) r->failed = 1;
+        streamClose(&ls);
+    }
+    if (fp) fclose(fp);
+
+    struct rusage ru;
+    getrusage(RUSAGE_SELF, &ru);
+    r->peakRssKb = ru.ru_maxrss;
+    free(names);
+    free(scopes);
+    free(first);
+    lexer_close(&lx);
+    free(c.data);
+}
+
+/* Measure in a child so each case's peak RSS is its own. */
+int runCase(Result *r, int reps, const char *dir) {
+    int fd[2];
+    if (pipe(fd) != 0) return -1;
+    pid_t pid = fork();
+    if (pid < 0) return -1;
+    if (pid == 0) {
+        close(fd[0]);
+        measure(r, reps, dir);
+        ssize_t n = write(fd[1], r, sizeof(*r));
+        _exit(n == sizeof(*r) ? 0 : 1);
+    }
+    close(fd[1]);
+    ssize_t n = read(fd[0], r, sizeof(*r));
+    close(fd[0]);
+    int status;
+    waitpid(pid, &status, 0);
+    return n == sizeof(*r) && WIFEXITED(status) && WEXITSTATUS(status) == 0 ? 0 : -1;
+}
+
+/* ---------------- REPORTS ---------------- */
+double mbPerSec(const Result *r) { return r->bytes / 1e6 / r->seconds; }
+double tokensPerSec(const Result *r) { return r->tokens / r->seconds; }
+double nsPerToken(const Result *r) { return r->tokens ? r->seconds * 1e9 / r->tokens : 0; }
+
+void writeJson(FILE *fp, const Result *results, int n, size_t size, int reps) {
+    fprintf(fp, "{\n  \"bytes\": %zu,\n  \"reps\": %d,\n  \"results\": [\n", size, reps);
+    for (int i = 0; i < n; i++) {
+        const Result *r = &results[i];
+        fprintf(fp, "    {\"lang\": \"%s\", \"mix\": \"%s\", \"bytes\": %zu, \"tokens\": %llu, "
+                "\"seconds\": %.6f, \"mbPerSec\": %.2f, \"tokensPerSec\": %.0f, \"nsPerToken\": %.3f, "
+                "\"peakRssKb\": %ld, \"symbols\": %u, \"insertsPerSec\": %.0f, \"lookupsPerSec\": %.0f}%s\n",
+                languages[r->lang].name, mixNames[r->mix], r->bytes, (unsigned long long)r->tokens,
+                r->seconds, mbPerSec(r), tokensPerSec(r), nsPerToken(r), r->peakRssKb, r->symbols,
+                r->insertsPerSec, r->lookupsPerSec, i + 1 < n ? "," : "");
+    }
+    fprintf(fp, "  ]\n}\n");
+}
+
+/* Value of "key" in a one-line JSON object; strings into str if given. */
+int jsonField(const char *line, const char *key, double *num, char *str, size_t size) {
+    char pattern[64];
+    snprintf(pattern, sizeof(pattern), "\"%s\":", key);
+    const char *p = strstr(line, pattern);
+    if (!p) return -1;
+    p += strlen(pattern);
+    while (*p == ' ') p++;
+    if (str) {
+        const char *q = *p == '"' ? strchr(p + 1, '"') : NULL;
+        if (!q || (size_t)(q - p - 1) >= size) return -1;
+        memcpy(str, p + 1, q - p - 1);
+        str[q - p - 1] = '\0';
+        return 0;
+    }
+    char *end;
+    *num = strtod(p, &end);
+    return end == p ? -1 : 0;
+}
+
+/* Compare against a baseline written by -o. Returns the number of
+ * regressions beyond threshold percent. */
+int compareBaseline(const char *path, const Result *results, int n, double threshold) {
+    static const char *higher[] = { "mbPerSec", "tokensPerSec", "insertsPerSec", "lookupsPerSec" };
+    FILE *fp = fopen(path, "r");
+    if (!fp) { fprintf(stderr, "lexbench: cannot open %s\n", path); return 1; }
+    char line[1024], lang[32], mix[32];
+    int regressions = 0, matched = 0;
+    printf("\nagainst %s (threshold %.0f%%):\n", path, threshold);
+    while (fgets(line, sizeof(line), fp)) {
+        if (jsonField(line, "lang", NULL, lang, sizeof(lang)) != 0 ||
+            jsonField(line, "mix", NULL, mix, sizeof(mix)) != 0)
+            continue;
+        for (int i = 0; i < n; i++) {
+            const Result *r = &results[i];
+            if (strcmp(lang, languages[r->lang].name) != 0 || strcmp(mix, mixNames[r->mix]) != 0)
+                continue;
+            double now[] = { mbPerSec(r), tokensPerSec(r), r->insertsPerSec, r->lookupsPerSec };
+            double old, change;
+            matched++;
+            for (int k = 0; k < 4; k++) {
+                if (jsonField(line, higher[k], &old, NULL, 0) != 0 || old <= 0) continue;
+                change = (now[k] - old) / old * 100;
+                if (change < -threshold) {
+                    printf("  REGRESSION %-8s %-11s %-13s %12.1f -> %12.1f (%+.1f%%)\n",
+                           lang, mix, higher[k], old, now[k], change);
+                    regressions++;
+                }
+            }
+            if (jsonField(line, "peakRssKb", &old, NULL, 0) == 0 && old > 0 &&
+                (change = (r->peakRssKb - old) / old * 100) > threshold) {
+                printf("  REGRESSION %-8s %-11s %-13s %12.0f -> %12ld (%+.1f%%)\n",
+                       lang, mix, "peakRssKb", old, r->peakRssKb, change);
+                regressions++;
+            }
+        }
+    }
+    fclose(fp);
+    printf("  %d cases compared, %d regressions\n", matched, regressions);
+    return regressions;
+}
+
+int lookupName(const char *s, const char **names, int count) {
+    for (int i = 0; i < count; i++)
+        if (strcmp(s, names[i]) == 0) return i;
+    return -1;
+}
+
+/* ---------------- MAIN ---------------- */
+int main(int argc, char **argv) {
+    double mb = DEFAULT_MB, threshold = DEFAULT_THRESHOLD;
+    int reps = DEFAULT_REPS, onlyLang = -1, onlyMix = -1;
+    const char *jsonPath = NULL, *baseline = NULL, *dir = NULL;
+    const char *langNames[LANG_COUNT];
+    for (int i = 0; i < LANG_COUNT; i++) langNames[i] = languages[i].name;
+
+    for (int i = 1; i < argc; i++) {
+        const char *arg = argv[i], *val = i + 1 < argc ? argv[i + 1] : NULL;
+        if (!val || arg[0] != '-' || strlen(arg) != 2) goto usage;
+        switch (arg[1]) {
+        case 's': mb = atof(val); break;
+        case 'r': reps = atoi(val); break;
+        case 'l': if ((onlyLang = lookupName(val, langNames, LANG_COUNT)) < 0) goto usage; break;
+        case 'm': if ((onlyMix = lookupName(val, mixNames, MIX_COUNT)) < 0) goto usage; break;
+        case 'w': dir = val; break;
+        case 'o': jsonPath = val; break;
+        case 'b': baseline = val; break;
+        case 't': threshold = atof(val); break;
+        default: goto usage;
+        }
+        i++;
+    }
+    if (mb <= 0 || reps <= 0) goto usage;
+
+    size_t size = (size_t)(mb * 1024 * 1024);
+    Result results[LANG_COUNT * MIX_COUNT];
+    int n = 0, failed = 0;
+    printf("%-8s %-11s %8s %8s %8s %9s %8s %10s %10s\n", "lang", "mix", "MB/s", "Mtok/s",
+           "ns/tok", "RSS MB", "symbols", "Mins/s", "Mlook/s");
+    for (int lang = 0; lang < LANG_COUNT; lang++) {
+        if (onlyLang >= 0 && lang != onlyLang) continue;
+        for (int mix = 0; mix < MIX_COUNT; mix++) {
+            if (onlyMix >= 0 && mix != onlyMix) continue;
+            Result *r = &results[n];
+            memset(r, 0, sizeof(*r));
+            r->lang = lang;
+            r->mix = mix;
+            r->bytes = size;
+            if (runCase(r, reps, dir) != 0 || r->failed) {
+                printf("%-8s %-11s failed", languages[lang].name, mixNames[mix]);
+                if (r->window > CHECK_WINDOW) printf(": streaming window grew to %zu KB", r->window / 1024);
+                printf("\n");
+                failed++;
+                continue;
+            }
+            printf("%-8s %-11s %8.1f %8.2f %8.2f %9.1f %8u %10.2f %10.2f\n",
+                   languages[lang].name, mixNames[mix], mbPerSec(r), tokensPerSec(r) / 1e6,
+                   nsPerToken(r), r->peakRssKb / 1024.0, r->symbols,
+                   r->insertsPerSec / 1e6, r->lookupsPerSec / 1e6);
+            n++;
+        }
+    }
+
+    if (jsonPath) {
+        FILE *fp = fopen(jsonPath, "w");
+        if (!fp) { printf("Cannot write %s\n", jsonPath); return 1; }
+        writeJson(fp, results, n, size, reps);
+        fclose(fp);
+    }
+    if (baseline && compareBaseline(baseline, results, n, threshold) > 0) return 1;
+    return failed ? 1 : 0;
+
+usage:
+    printf("usage: %s [-s MB] [-r reps] [-l lang] [-m mix] [-w dir]\n"
+           "       [-o results.json] [-b baseline.json] [-t percent]\n", argv[0]);
+    return 1;
+}
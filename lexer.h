@@ -0,0 +1,945 @@
+#ifndef LEXER_H
+#define LEXER_H
+
+/* ================= LEXER LIBRARY =================
+ * Pull-based tokenizer behind all the command line lexers. The caller owns
+ * the input buffer; a Lexer is a cursor over it plus the symbol table it
+ * builds, and lexer_next() hands back one token at a time by value. Token
+ * text is a view into the buffer, so nothing is allocated per token and
+ * nothing is read or printed here. All state lives in the Lexer, so any
+ * number of them can run side by side.
+ *
+ *   Lexer lx;
+ *   Token t;
+ *   if (lexer_open(&lx, data, len, LANG_SQL) != 0) ...
+ *   while (lexer_next(&lx, &t))
+ *       ...
+ *   lexer_close(&lx);
+ *
+ * There is one engine for every language. lexer_open() compiles the
+ * language's descriptor (languages.h) into a 256-entry byte class table,
+ * which picks the scanner for the byte at the cursor, and a DFA over the
+ * punctuation bytes that recognises operators, delimiters, quotes and
+ * comment openers by longest match. Runs of blanks, identifier bodies and
+ * block comment bodies go through the vector kernels in scan.h. Numeric
+ * literals follow the language's syntax and are converted as they are
+ * scanned, eight decimal digits at a time, into Token.number.
+ *
+ * In a layout language (def->layout: Python) a TOK_NEWLINE ends every
+ * logical line; indent.h turns the indentation of the line after it into
+ * TOK_INDENT and TOK_DEDENT tokens.
+ *
+ * Built with -DSYMTAB_STATS, lexer_close() reports on the health of the
+ * symbol table to stderr (see lexReport()), and so does every lexer still
+ * entering symbols when the process gets SIGUSR1.
+ *
+ * Built with -DLEX_STATS, every lexer also keeps phase timers and token
+ * counts (lexstats.h), which lexer_stats_report() prints.
+ */
+#include <ctype.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include "lexinput.h"
+#include "kwhash.h"
+#include "intern.h"
+#include "token.h"
+#include "languages.h"
+#include "scan.h"
+#include "lexstats.h"
+
+/* Bump whenever the same input can lex to different tokens or symbols:
+ * cached results (tokcache.h) are keyed on it. */
+#define LEXER_VERSION 7
+
+/* A numeric literal's value, converted while it is scanned. */
+typedef struct numberValue {
+    union {
+        uint64_t i;      // integer literals, wrapped if overflow is set
+        double f;        // float literals: a fraction, an exponent or a float suffix
+    };
+    uint8_t isFloat;
+    uint8_t overflow;    // the integer does not fit in 64 bits
+    uint8_t suffix;      // length of the suffix ending the text ("u32", "L", "f")
+} NumberValue;
+
+typedef struct token {
+    TokenKind kind;
+    Lexeme text;         // view into the input; string contents without quotes
+    int row, col;        // col counts bytes from the start of the line, from 1
+    int keyword;         // keyword id for TOK_KEYWORD, -1 otherwise
+    int quotes;          // bytes of quotes before and after text: 1 or 3 for a string, else 0
+    NumberValue number;  // TOK_NUMBER only
+} Token;
+
+/* ---------------- TABLES ---------------- */
+
+/* Byte classes. The low bits pick the scanner; the flag marks bytes that
+ * continue an identifier. */
+enum {
+    CC_UNKNOWN, CC_SPACE, CC_NEWLINE, CC_IDENT, CC_DIGIT, CC_PUNCT,
+    CC_KIND = 0x0f,
+    CC_WORD = 0x10
+};
+
+/* What the longest punctuation match stands for. */
+typedef enum lexAction {
+    ACT_NONE, ACT_OP, ACT_DELIM, ACT_STRING, ACT_CHAR,
+    ACT_LINE_COMMENT, ACT_BLOCK_COMMENT, ACT_TRIPLE, ACT_PREPROC, ACT_JOIN
+} LexAction;
+
+#define LEX_SHORT_WORD 16    // identifier bytes scanned before switching to scan->wordEnd
+#define LEX_MAX_STATES 128
+#define LEX_MAX_COLUMNS 32
+
+typedef struct lexTables {
+    uint8_t charClass[256];
+    uint8_t column[256];                             // punctuation byte -> DFA column, 0 = none
+    uint8_t next[LEX_MAX_STATES][LEX_MAX_COLUMNS];   // 0 = no transition
+    uint8_t accept[LEX_MAX_STATES];                  // LexAction of the string ending here
+    int states, columns;
+} LexTables;
+
+/* Add s to the DFA as a path from the start state ending in action. */
+static int lexAddString(LexTables *tb, const char *s, int len, LexAction action) {
+    int state = 0;
+    for (int i = 0; i < len; i++) {
+        uint8_t c = s[i];
+        if (!tb->column[c]) {
+            if (tb->columns == LEX_MAX_COLUMNS) return -1;
+            tb->column[c] = tb->columns++;
+        }
+        uint8_t *to = &tb->next[state][tb->column[c]];
+        if (!*to) {
+            if (tb->states == LEX_MAX_STATES) return -1;
+            *to = tb->states++;
+        }
+        state = *to;
+    }
+    tb->accept[state] = action;
+    return 0;
+}
+
+/* Add each byte of set, or each run of `width` bytes, as its own string. */
+static int lexAddEach(LexTables *tb, const char *set, int width, LexAction action) {
+    for (; set && *set; set += width)
+        if (lexAddString(tb, set, width, action) != 0) return -1;
+    return 0;
+}
+
+/* Build the tables for def; -1 if the DFA outgrows its fixed size. Later
+ * rules win over earlier ones for the same string. */
+static int lexCompile(LexTables *tb, const LanguageDef *def) {
+    memset(tb, 0, sizeof(*tb));
+    tb->states = tb->columns = 1;
+    int rc = lexAddEach(tb, def->operators, 1, ACT_OP);
+    for (const char *op = def->operators; def->opEquals && *op; op++) {
+        char pair[2] = { *op, '=' };
+        rc |= lexAddString(tb, pair, 2, ACT_OP);
+    }
+    rc |= lexAddEach(tb, def->pairs, 2, ACT_OP);
+    rc |= lexAddEach(tb, def->delimiters, 1, ACT_DELIM);
+    rc |= lexAddEach(tb, def->quotes, 1, ACT_STRING);
+    rc |= lexAddEach(tb, def->charQuotes, 1, ACT_CHAR);
+    if (def->tripleQuotes) {
+        rc |= lexAddString(tb, "'''", 3, ACT_TRIPLE);
+        rc |= lexAddString(tb, "\"\"\"", 3, ACT_TRIPLE);
+    }
+    if (def->lineComment)
+        rc |= lexAddString(tb, def->lineComment, strlen(def->lineComment), ACT_LINE_COMMENT);
+    if (def->blockOpen)
+        rc |= lexAddString(tb, def->blockOpen, strlen(def->blockOpen), ACT_BLOCK_COMMENT);
+    if (def->preproc)
+        rc |= lexAddString(tb, def->preproc, strlen(def->preproc), ACT_PREPROC);
+    if (def->layout) {
+        rc |= lexAddString(tb, "\\\n", 2, ACT_JOIN);
+        rc |= lexAddString(tb, "\\\r\n", 3, ACT_JOIN);
+    }
+    if (rc != 0) return -1;
+
+    for (int c = 0; c < 256; c++) {
+        uint8_t cls = CC_UNKNOWN;
+        if (c == '\n') cls = CC_NEWLINE;
+        else if (isspace(c)) cls = CC_SPACE;
+        else if (isalpha(c) || c == '_') cls = CC_IDENT;
+        else if (isdigit(c)) cls = CC_DIGIT;
+        else if (tb->next[0][tb->column[c]]) cls = CC_PUNCT;
+        if (isalnum(c) || c == '_') cls |= CC_WORD;
+        tb->charClass[c] = cls;
+    }
+    return 0;
+}
+
+/* ---------------- LEXER ---------------- */
+typedef enum { SYM_IDENTIFIER, SYM_FUNC } SymbolType;
+
+typedef struct symbol {
+    uint32_t name;       // id in names
+    uint32_t scope;      // id of the scope it was entered in
+    uint8_t type;        // SymbolType
+} Symbol;
+
+/* A scope's id is its place in Lexer.scopes; the Global scope is 0 and its
+ * own parent. A function's scope is named after it, a block after the
+ * scope it is in. */
+typedef struct lexScope {
+    uint32_t name;       // id in names
+    uint32_t parent;
+} LexScope;
+
+typedef struct lexer {
+    Source src;              // cursor over the caller's buffer, not owned
+    Language lang;
+    const LanguageDef *def;
+    LexTables tables;
+    const ScanKernels *scan;
+    KeywordTable keywords;
+    int row;
+    size_t lineStart;        // offset of the first byte of the current line
+    size_t limit;            // lexer_next stops before a token starting here or later
+    int prevKeyword;         // keyword id of the previous token, -1 if not a keyword
+    int midLine;             // a token has been seen since the last line break
+    int brackets;            // ( [ { open, in a layout language
+    size_t cutComment;       // start of a comment the buffer ends inside, else SIZE_MAX
+    int callAfter;           // keyword id of def->callAfter, -1 if none
+    int deferSymbols;        // leave symbols to the caller (lexRecord)
+    uint32_t scope;          // innermost open scope, where new identifiers go
+    int inHeader;            // scope is a function's, entered at its name; no '{' yet
+    uint32_t globalScope;    // id of the Global scope
+    StringPool names;        // symbol and scope names, stored once
+    Symbol *symbols;         // in insertion order
+    uint32_t symbolCount, symbolCap;
+    HashIndex symbolIndex;   // keyed on (name, scope)
+    LexScope *scopes;        // every scope opened so far, by id
+    uint32_t scopeCount, scopeCap;
+    HashIndex scopeIndex;    // keyed on (name, parent)
+#ifdef SYMTAB_STATS
+    uint64_t duplicates;     // lexAddSymbol() calls that found the symbol already there
+    int statsSeen;           // SIGUSR1 requests answered
+#endif
+#ifdef LEX_STATS
+    LexStats stats;
+#endif
+} Lexer;
+
+/* ---------------- SYMBOLS ---------------- */
+typedef struct symbolKey {
+    const Lexer *lx;
+    uint32_t name, scope;
+} SymbolKey;
+
+static inline int lexSymbolMatches(const void *key, uint32_t entry) {
+    const SymbolKey *k = key;
+    const Symbol *s = &k->lx->symbols[entry];
+    return s->name == k->name && s->scope == k->scope;
+}
+
+static inline int lexScopeMatches(const void *key, uint32_t id) {
+    const SymbolKey *k = key;
+    const LexScope *s = &k->lx->scopes[id];
+    return s->name == k->name && s->parent == k->scope;
+}
+
+#ifdef SYMTAB_STATS
+#include <signal.h>
+#include <stdio.h>
+
+static volatile sig_atomic_t lexStatsRequests;
+
+static void lexStatsSignal(int sig) {
+    (void)sig;
+    lexStatsRequests++;
+}
+
+/* Counts, memory per symbol and both hash indexes. Counters run on across
+ * lexer_reset(); the tables describe the current input. */
+static void lexReport(FILE *fp, Lexer *lx) {
+    const StringPool *p = &lx->names;
+    size_t records = (size_t)lx->symbolCap * sizeof(Symbol);
+    size_t index = lx->symbolIndex.slots ? (size_t)(lx->symbolIndex.mask + 1) * sizeof(Slot) : 0;
+    size_t names = p->cap + (size_t)p->idCap * sizeof(uint32_t) +
+                   (p->index.slots ? (size_t)(p->index.mask + 1) * sizeof(Slot) : 0);
+    double n = lx->symbolCount ? lx->symbolCount : 1;
+    uint64_t adds = lx->duplicates + lx->symbolIndex.counters.inserts;
+    flockfile(fp);
+    fprintf(fp, "== symbol table (%s): %u symbols, %u names, %u scopes\n", lx->def->name,
+            lx->symbolCount, p->count, lx->scopeCount);
+    fprintf(fp, "duplicate inserts: %llu of %llu (%.1f%%)\n", (unsigned long long)lx->duplicates,
+            (unsigned long long)adds, adds ? 100.0 * lx->duplicates / adds : 0.0);
+    fprintf(fp, "bytes per symbol: %.1f allocated (records %.1f, index %.1f, names %.1f)\n",
+            (records + index + names) / n, records / n, index / n, names / n);
+    hiReport(fp, "symbol index", &lx->symbolIndex);
+    hiReport(fp, "name index", &p->index);
+    funlockfile(fp);
+    lx->statsSeen = lexStatsRequests;
+}
+#endif
+
+static inline uint32_t lexSymbolHash(uint32_t name, uint32_t scope) {
+    return (name * 0x9E3779B1u) ^ (scope * 0x85EBCA77u);
+}
+
+/* Record the name with id name in scope unless it is already there;
+ * returns its entry. */
+static uint32_t lexAddName(Lexer *lx, uint32_t name, uint32_t scope, SymbolType type) {
+    SymbolKey key = { lx, name, scope };
+    uint32_t h = lexSymbolHash(key.name, key.scope);
+    int found = hiFind(&lx->symbolIndex, h, lexSymbolMatches, &key);
+    if (found >= 0) {
+        SYMSTAT(lx->duplicates++;)
+        return found;
+    }
+    if (lx->symbolCount == lx->symbolCap) {
+        lx->symbolCap = lx->symbolCap ? lx->symbolCap * 2 : 64;
+        lx->symbols = realloc(lx->symbols, lx->symbolCap * sizeof(Symbol));
+    }
+    Symbol *s = &lx->symbols[lx->symbolCount];
+    s->name = key.name;
+    s->scope = scope;
+    s->type = type;
+    hiInsert(&lx->symbolIndex, h, lx->symbolCount);
+    return lx->symbolCount++;
+}
+
+static inline uint32_t lexAddSymbol(Lexer *lx, Lexeme name, uint32_t scope, SymbolType type) {
+    return lexAddName(lx, poolIntern(&lx->names, name.ptr, name.len), scope, type);
+}
+
+/* The entry name resolves to from the current scope, innermost scope
+ * first; entered in the current scope if no open scope has it. */
+static uint32_t lexResolve(Lexer *lx, Lexeme name) {
+    SymbolKey key = { lx, poolIntern(&lx->names, name.ptr, name.len), lx->scope };
+    for (;;) {
+        int found = hiFind(&lx->symbolIndex, lexSymbolHash(key.name, key.scope), lexSymbolMatches, &key);
+        if (found >= 0) {
+            SYMSTAT(lx->duplicates++;)
+            return found;
+        }
+        if (key.scope == lx->globalScope) break;
+        key.scope = lx->scopes[key.scope].parent;
+    }
+    return lexAddName(lx, key.name, lx->scope, SYM_IDENTIFIER);
+}
+
+/* Id of the scope named name directly inside parent, made on first use.
+ * Opening the same block again gives the same id, so a lexer restarted at
+ * a LexState comes back to the scopes it saw before. */
+static uint32_t lexScopeIn(Lexer *lx, uint32_t parent, uint32_t name) {
+    SymbolKey key = { lx, name, parent };
+    uint32_t h = lexSymbolHash(name, parent);
+    int found = hiFind(&lx->scopeIndex, h, lexScopeMatches, &key);
+    if (found >= 0) return found;
+    if (lx->scopeCount == lx->scopeCap) {
+        lx->scopeCap = lx->scopeCap ? lx->scopeCap * 2 : 16;
+        lx->scopes = realloc(lx->scopes, lx->scopeCap * sizeof(LexScope));
+    }
+    lx->scopes[lx->scopeCount].name = name;
+    lx->scopes[lx->scopeCount].parent = parent;
+    hiInsert(&lx->scopeIndex, h, lx->scopeCount);
+    return lx->scopeCount++;
+}
+
+static inline const char *lexScopeName(const Lexer *lx, uint32_t scope) {
+    return poolString(&lx->names, lx->scopes[scope].name);
+}
+
+/* Scope moves in a scoped language. A function named at the top level is
+ * entered there, so its parameters are its own; its '{' then opens the
+ * body in that same scope, and a ';' first (a prototype or a call) leaves
+ * it. Any other '{' opens a block and '}' closes the innermost scope. */
+static void lexScopeDelim(Lexer *lx, char c) {
+    if (c == '{') {
+        if (!lx->inHeader) lx->scope = lexScopeIn(lx, lx->scope, lx->scopes[lx->scope].name);
+        lx->inHeader = 0;
+    } else if (c == '}' || (c == ';' && lx->inHeader)) {
+        lx->scope = lx->scopes[lx->scope].parent;
+        lx->inHeader = 0;
+    }
+}
+
+/* Enter an identifier or function token into the symbol table and return
+ * its entry, or -1 for other tokens. In a scoped language identifiers
+ * resolve innermost scope first and delimiters move the scope. */
+static int lexRecord(Lexer *lx, const Token *t) {
+    SYMSTAT(if (lx->statsSeen != lexStatsRequests) lexReport(stderr, lx);)
+    LEXSTAT(uint64_t started = statTick();)
+    int entry = -1;
+    if (t->kind == TOK_IDENTIFIER) {
+        entry = lx->def->scoped ? lexResolve(lx, t->text)
+                                : lexAddSymbol(lx, t->text, lx->scope, SYM_IDENTIFIER);
+    } else if (t->kind == TOK_FUNC) {
+        entry = lexAddSymbol(lx, t->text, lx->globalScope, SYM_FUNC);
+        if (lx->def->scoped && lx->scope == lx->globalScope && !lx->inHeader) {
+            lx->scope = lexScopeIn(lx, lx->globalScope, lx->symbols[entry].name);
+            lx->inHeader = 1;
+        }
+    } else if (t->kind == TOK_DELIM && lx->def->scoped) {
+        lexScopeDelim(lx, t->text.ptr[0]);
+    }
+    LEXSTAT(lx->stats.ticks[ST_SYMBOLS] += statTick() - started;)
+    return entry;
+}
+
+/* ---------------- SCANNERS ---------------- */
+
+/* Fill t with [p, p+len) and leave the cursor at resume. */
+static inline int lexEmit(Lexer *lx, Token *t, TokenKind kind, const char *p, int len, const char *resume) {
+    t->kind = kind;
+    t->text.ptr = p;
+    t->text.len = len;
+    t->row = lx->row;
+    t->col = (int)(p - lx->src.data - lx->lineStart) + 1;
+    t->keyword = -1;
+    t->quotes = 0;
+    lx->prevKeyword = -1;
+    lx->midLine = 1;
+    lx->src.pos = resume - lx->src.data;
+    return 1;
+}
+
+/* Fill t with a string opened by the len quotes at p and closed at close,
+ * or unclosed if close is end: the text is the body between them, and the
+ * row and column are those of the opening quote. */
+static inline int lexEmitQuoted(Lexer *lx, Token *t, TokenKind kind, const char *p, int len,
+                                const char *close, const char *end) {
+    lexEmit(lx, t, kind, p, 0, close < end ? close + len : end);
+    t->text.ptr = p + len;
+    t->text.len = (int)(close - p - len);
+    t->quotes = len;
+    return 1;
+}
+
+/* Account for the lines in [p, end), which the cursor is skipping over. */
+static inline void lexLines(Lexer *lx, const char *p, const char *end) {
+    while ((p = memchr(p, '\n', end - p)) != NULL) {
+        lx->row++;
+        lx->lineStart = ++p - lx->src.data;
+    }
+}
+
+/* First occurrence of s[0..len) in [p, end), or NULL. */
+static inline const char *lexFind(const Lexer *lx, const char *p, const char *end, const char *s, int len) {
+    if (len == 1) return memchr(p, s[0], end - p);
+    while ((p = lx->scan->findPair(p, end, s[0], s[1])) != NULL) {
+        if (end - p >= len && memcmp(p + 2, s + 2, len - 2) == 0) return p;
+        p++;
+    }
+    return NULL;
+}
+
+/* The quotes s[0..len) closing a string whose body starts at body, or
+ * NULL. With def->escapes a quote behind an odd run of backslashes is
+ * part of the body; the search goes on from the byte after it. */
+static inline const char *lexCloseQuote(const Lexer *lx, const char *body, const char *end, const char *s, int len) {
+    const char *p = body;
+    while ((p = lexFind(lx, p, end, s, len)) != NULL) {
+        if (!lx->def->escapes) return p;
+        const char *q = p;
+        while (q > body && q[-1] == '\\') q--;
+        if ((p - q) % 2 == 0) return p;
+        p++;
+    }
+    return NULL;
+}
+
+static int lexWord(Lexer *lx, Token *t, const char *p) {
+    const char *start = p, *end = lx->src.data + lx->src.len;
+    const uint8_t *cls = lx->tables.charClass;
+    const LanguageDef *def = lx->def;
+    while (++p < end && (cls[(uint8_t)*p] & CC_WORD))
+        if (p - start == LEX_SHORT_WORD) {   // long name: finish it vectorised
+            p = lx->scan->wordEnd(p, end);
+            break;
+        }
+    Lexeme w = { start, (int)(p - start) };
+
+    LEXSTAT(uint64_t started = statTick();)
+    int id = kwLookup(&lx->keywords, w.ptr, w.len);
+    LEXSTAT(lx->stats.ticks[ST_KEYWORDS] += statTick() - started;)
+    if (id >= 0) {
+        lexEmit(lx, t, TOK_KEYWORD, w.ptr, w.len, p);
+        t->keyword = lx->prevKeyword = id;
+        return 1;
+    }
+
+    int call = def->calls && p < end && *p == '(' &&
+               (!def->callAfter || lx->prevKeyword == lx->callAfter);
+    lexEmit(lx, t, call ? TOK_FUNC : TOK_IDENTIFIER, w.ptr, w.len, p);
+    if (!lx->deferSymbols) lexRecord(lx, t);
+    return 1;
+}
+
+/* ---------------- NUMBERS ---------------- */
+typedef struct digitRun {
+    uint64_t v;
+    int digits;          // taken into v, separators not counted
+    int overflow;
+} DigitRun;
+
+static inline int lexIsDigit(char c) {
+    return (unsigned)(c - '0') < 10;
+}
+
+/* Value of c as a digit in bases up to 36, or 36 if it is none. */
+static inline unsigned lexDigitValue(char c) {
+    unsigned d = (unsigned)(c - '0'), l = (unsigned)((c | 0x20) - 'a');
+    return d < 10 ? d : l < 26 ? l + 10 : 36;
+}
+
+/* Decimal digits from p, with '_' between them if underscores, added onto
+ * run. Eight at a time while they last: the bytes are checked to be digits
+ * and combined into their value in registers, a pair, a quad, then all
+ * eight, with three multiplies. */
+static inline const char *lexDigits(const char *p, const char *end, int underscores, DigitRun *run) {
+    for (;;) {
+#if __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+        while (end - p >= 8) {
+            uint64_t x, v;
+            memcpy(&x, p, 8);
+            if (((x & 0xF0F0F0F0F0F0F0F0ull) |
+                 (((x + 0x0606060606060606ull) & 0xF0F0F0F0F0F0F0F0ull) >> 4)) != 0x3333333333333333ull)
+                break;
+            x = ((x & 0x0F0F0F0F0F0F0F0Full) * 2561) >> 8;
+            x = ((x & 0x00FF00FF00FF00FFull) * 6553601) >> 16;
+            x = ((x & 0x0000FFFF0000FFFFull) * 42949672960001ull) >> 32;
+            run->overflow |= __builtin_mul_overflow(run->v, 100000000ull, &v) |
+                             __builtin_add_overflow(v, x, &run->v);
+            run->digits += 8;
+            p += 8;
+        }
+#endif
+        if (p < end && lexIsDigit(*p)) {
+            uint64_t v;
+            run->overflow |= __builtin_mul_overflow(run->v, 10ull, &v) |
+                             __builtin_add_overflow(v, (uint64_t)(*p - '0'), &run->v);
+            run->digits++;
+            p++;
+        } else if (underscores && end - p > 1 && *p == '_' && lexIsDigit(p[1])) {
+            p++;
+        } else {
+            return p;
+        }
+    }
+}
+
+/* Digits of a power of two radix from p, into n; stops at the first byte
+ * that is not one. */
+static inline const char *lexRadixDigits(const char *p, const char *end, unsigned radix, int underscores,
+                                         NumberValue *n) {
+    int bits = radix == 16 ? 4 : radix == 8 ? 3 : 1;
+    for (; p < end; p++) {
+        unsigned d = lexDigitValue(*p);
+        if (d >= radix) {
+            if (underscores && end - p > 1 && *p == '_' && lexDigitValue(p[1]) < radix) continue;
+            break;
+        }
+        n->overflow |= (n->i >> (64 - bits)) != 0;
+        n->i = n->i << bits | d;
+    }
+    return p;
+}
+
+static const double lexPowers[] = {
+    1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11,
+    1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22
+};
+
+/* The float [p, end) whose digits are mantissa, with decimal exponent e.
+ * Mantissas up to 2^53 and exponents up to 22 are exact as doubles, so one
+ * multiply or divide rounds correctly; anything else goes to strtod(). */
+static double lexFloatValue(const char *p, const char *end, const DigitRun *mantissa, long e) {
+    if (!mantissa->overflow && mantissa->v <= (1ull << 53) && e >= -22 && e <= 22)
+        return e < 0 ? (double)mantissa->v / lexPowers[-e] : (double)mantissa->v * lexPowers[e];
+    char small[128], *text = end - p < (long)sizeof(small) ? small : malloc(end - p + 1);
+    if (!text) return 0;
+    int len = 0;
+    for (; p < end; p++)
+        if (*p != '_') text[len++] = *p;
+    text[len] = '\0';
+    double f = strtod(text, NULL);
+    if (text != small) free(text);
+    return f;
+}
+
+/* Whether [p, p+len) is one of the space separated suffixes. */
+static inline int lexIsSuffix(const char *suffixes, const char *p, int len) {
+    for (const char *s = suffixes; s && *s; ) {
+        int n = (int)strcspn(s, " ");
+        if (n == len && memcmp(s, p, len) == 0) return 1;
+        s += n + (s[n] == ' ');
+    }
+    return 0;
+}
+
+/* A numeric literal in the language's syntax (LanguageDef.numbers), with
+ * its value in t->number. A literal ends where its syntax does: "1..2" is
+ * a number, an operator and a number, "1.max()" leaves ".max" alone, and
+ * a run of name bytes after it is taken only if it is one of the suffixes. */
+static int lexNumber(Lexer *lx, Token *t, const char *p) {
+    const char *start = p, *end = lx->src.data + lx->src.len;
+    const uint8_t *cls = lx->tables.charClass;
+    const LanguageDef *def = lx->def;
+    int syntax = def->numbers, underscores = syntax & NUM_UNDERSCORE;
+    NumberValue n;
+    memset(&n, 0, sizeof(n));
+
+    unsigned radix = 0;
+    if (*p == '0' && end - p > 2) {
+        char c = p[1] | 0x20;
+        radix = c == 'x' && (syntax & NUM_HEX)    ? 16 :
+                c == 'o' && (syntax & NUM_OCTAL)  ? 8 :
+                c == 'b' && (syntax & NUM_BINARY) ? 2 : 0;
+        if (radix && lexDigitValue(p[2]) >= radix) radix = 0;   // "0x" alone is 0, then a name
+    }
+    if (radix) {
+        p = lexRadixDigits(p + 2, end, radix, underscores, &n);
+    } else {
+        DigitRun run = { 0, 0, 0 };
+        long e = 0;
+        p = lexDigits(p, end, underscores, &run);
+        int whole = run.digits;
+        if ((syntax & NUM_FRACTION) && p < end && *p == '.') {
+            if (end - p > 1 && lexIsDigit(p[1])) {
+                p = lexDigits(p + 1, end, underscores, &run);
+                n.isFloat = 1;
+            } else if (end - p == 1 || (!(cls[(uint8_t)p[1]] & CC_WORD) && p[1] != '.')) {
+                p++;
+                n.isFloat = 1;
+            }
+        }
+        if ((syntax & NUM_EXPONENT) && p < end && (*p | 0x20) == 'e') {
+            const char *q = p + 1;
+            int negative = q < end && *q == '-';
+            if (q < end && (*q == '+' || *q == '-')) q++;
+            if (q < end && lexIsDigit(*q)) {
+                long x = 0;
+                for (; q < end && (lexIsDigit(*q) || (underscores && *q == '_')); q++)
+                    if (*q != '_' && x < 100000) x = x * 10 + (*q - '0');
+                e = negative ? -x : x;
+                p = q;
+                n.isFloat = 1;
+            }
+        }
+        if (n.isFloat) {
+            n.f = lexFloatValue(start, p, &run, e - (run.digits - whole));
+        } else {
+            n.i = run.v;
+            n.overflow = (uint8_t)run.overflow;
+            if ((syntax & NUM_LEADING_ZERO) && *start == '0' && p - start > 1) {
+                NumberValue octal;
+                memset(&octal, 0, sizeof(octal));
+                if (lexRadixDigits(start, p, 8, underscores, &octal) == p) n = octal;
+            }
+        }
+    }
+
+    const char *q = p;
+    while (q < end && (cls[(uint8_t)*q] & CC_WORD)) q++;
+    if (q > p && lexIsSuffix(def->numberSuffixes, p, (int)(q - p))) {
+        if (!n.isFloat && strchr("fFdDjJ", *p)) {
+            n.f = (double)n.i;
+            n.isFloat = 1;
+        }
+        n.suffix = (uint8_t)(q - p);
+        p = q;
+    }
+    lexEmit(lx, t, TOK_NUMBER, start, (int)(p - start), p);
+    t->number = n;
+    return 1;
+}
+
+/* Count the brackets a layout language's lines run on inside. A stray
+ * closing one is ignored. */
+static inline void lexBracket(Lexer *lx, char c) {
+    if (c == '(' || c == '[' || c == '{') lx->brackets++;
+    else if ((c == ')' || c == ']' || c == '}') && lx->brackets > 0) lx->brackets--;
+}
+
+/* Run the punctuation DFA at *p and act on the longest match. Returns 1
+ * with a token in t, or 0 with *p moved past a comment. */
+static int lexPunct(Lexer *lx, Token *t, const char **at) {
+    const LexTables *tb = &lx->tables;
+    const char *p = *at, *end = lx->src.data + lx->src.len;
+    int state = 0, action = ACT_NONE, len = 0;
+    for (int i = 0; p + i < end; i++) {
+        state = tb->next[state][tb->column[(uint8_t)p[i]]];
+        if (!state) break;
+        if (tb->accept[state]) { action = tb->accept[state]; len = i + 1; }
+    }
+
+    const char *body = p + len, *close;
+    switch (action) {
+    case ACT_OP:
+        return lexEmit(lx, t, TOK_OP, p, len, body);
+    case ACT_DELIM:
+        lexEmit(lx, t, TOK_DELIM, p, len, body);
+        if (lx->def->scoped && !lx->deferSymbols) lexRecord(lx, t);
+        if (lx->def->layout) lexBracket(lx, *p);
+        return 1;
+    case ACT_STRING:
+    case ACT_CHAR:
+        close = lexCloseQuote(lx, body, end, p, 1);
+        if (!close) close = end;
+        lexEmitQuoted(lx, t, action == ACT_STRING ? TOK_STRING : TOK_CHAR, p, 1, close, end);
+        lexLines(lx, body, close);
+        return 1;
+    case ACT_PREPROC:
+        close = memchr(body, '\n', end - body);
+        return lexEmit(lx, t, TOK_PREPROC, p, len, close ? close : end);
+    case ACT_LINE_COMMENT:
+        close = memchr(body, '\n', end - body);
+        if (!close) lx->cutComment = p - lx->src.data;
+        *at = close ? close : end;
+        LEXSTAT(lx->stats.comments++; lx->stats.commentBytes += *at - p;)
+        return 0;
+    case ACT_TRIPLE: {
+        // a docstring starts a logical line: not inside brackets, nor after a '\' join (midLine stays set)
+        TokenKind kind = lx->midLine || lx->brackets ? TOK_STRING : TOK_DOCSTRING;
+        close = lexCloseQuote(lx, body, end, p, len);
+        if (!close) close = end;
+        lexEmitQuoted(lx, t, kind, p, len, close, end);
+        lexLines(lx, body, close);
+        return 1;
+    }
+    case ACT_JOIN:    // the line goes on after the break
+        lx->row++;
+        lx->lineStart = body - lx->src.data;
+        *at = body;
+        return 0;
+    case ACT_BLOCK_COMMENT: {
+        int closeLen = (int)strlen(lx->def->blockClose);
+        close = lexFind(lx, body, end, lx->def->blockClose, closeLen);
+        if (!close) lx->cutComment = p - lx->src.data;
+        close = close ? close + closeLen : end;
+        lexLines(lx, body, close);
+        *at = close;
+        LEXSTAT(lx->stats.comments++; lx->stats.commentBytes += close - p;)
+        return 0;
+    }
+    default:
+        if (lx->def->skipUnknown) {
+            *at = p + 1;
+            LEXSTAT(lx->stats.skippedBytes++;)
+            return 0;
+        }
+        return lexEmit(lx, t, TOK_INVALID, p, 1, p + 1);
+    }
+}
+
+/* ---------------- API ---------------- */
+
+/* Point an open lexer at a new buffer, keeping its compiled tables and
+ * starting a fresh symbol table. Far cheaper than closing and reopening,
+ * since building a keyword table can take most of a millisecond. */
+static void lexer_reset(Lexer *lx, const char *data, size_t len) {
+    lx->src.data = data;
+    lx->src.len = len;
+    lx->src.pos = 0;
+    lx->limit = len;
+    lx->row = 1;
+    lx->lineStart = 0;
+    lx->prevKeyword = -1;
+    lx->midLine = 0;
+    lx->brackets = 0;
+    lx->cutComment = SIZE_MAX;
+    LEXSTAT(lx->stats.bytes += len;)
+    poolClear(&lx->names);
+    lx->symbolCount = 0;
+    hiClear(&lx->symbolIndex);
+    lx->scopeCount = 0;
+    hiClear(&lx->scopeIndex);
+    lx->globalScope = lx->scope = lexScopeIn(lx, 0, poolInternString(&lx->names, "Global"));
+    lx->inHeader = 0;
+}
+
+/* Start lexing data[0..len) as lang. The buffer must outlive the lexer.
+ * Returns 0 on success, -1 if the language's tables cannot be built. */
+static inline int lexer_open(Lexer *lx, const char *data, size_t len, Language lang) {
+    const LanguageDef *def = &languages[lang];
+    memset(lx, 0, sizeof(*lx));
+    lx->lang = lang;
+    lx->def = def;
+    lx->callAfter = -1;
+    lx->scan = scanSelect();
+    LEXSTAT(statStart(&lx->stats);)
+    SYMSTAT(signal(SIGUSR1, lexStatsSignal);)
+    if (lexCompile(&lx->tables, def) != 0 ||
+        kwBuild(&lx->keywords, def->keywords, def->keywordCount, def->caseless) != 0)
+        return -1;
+    if (def->callAfter &&
+        (lx->callAfter = kwLookup(&lx->keywords, def->callAfter, strlen(def->callAfter))) < 0)
+        return -1;
+    lexer_reset(lx, data, len);
+    LEXSTAT(lx->stats.ticks[ST_SETUP] += statTick() - lx->stats.startTick;)
+    return 0;
+}
+
+static inline int lexScan(Lexer *lx, Token *t) {
+    const uint8_t *cls = lx->tables.charClass;
+    const char *data = lx->src.data, *end = data + lx->src.len;
+    const char *p = data + lx->src.pos, *stop = data + lx->limit;
+    while (p < stop) {
+        switch (cls[(uint8_t)*p] & CC_KIND) {
+        case CC_SPACE:
+            if (++p < end && (cls[(uint8_t)*p] & CC_KIND) == CC_SPACE)
+                p = lx->scan->skipBlanks(p, end);
+            break;
+        case CC_NEWLINE:
+            if (lx->midLine && !lx->brackets && lx->def->layout) {
+                lexEmit(lx, t, TOK_NEWLINE, p, 0, p + 1);
+                lx->row++;
+                lx->lineStart = lx->src.pos;
+                lx->midLine = 0;
+                return 1;
+            }
+            lx->row++;
+            lx->lineStart = ++p - data;
+            lx->midLine = 0;
+            break;
+        case CC_IDENT:
+            return lexWord(lx, t, p);
+        case CC_DIGIT:
+            return lexNumber(lx, t, p);
+        default:
+            if (lexPunct(lx, t, &p)) return 1;
+        }
+    }
+    if (p == end && lx->midLine && lx->def->layout) {    // the last line, even inside brackets
+        lexEmit(lx, t, TOK_NEWLINE, p, 0, p);
+        lx->midLine = 0;
+        return 1;
+    }
+    int prev = lx->prevKeyword, midLine = lx->midLine;   // not a token: keep them for lexing on past limit
+    lexEmit(lx, t, TOK_EOF, p, 0, p);
+    lx->prevKeyword = prev;
+    lx->midLine = midLine;
+    return 0;
+}
+
+/* Fill t with the next token; returns 1, or 0 with t->kind == TOK_EOF once
+ * the input is exhausted. */
+static inline int lexer_next(Lexer *lx, Token *t) {
+#ifdef LEX_STATS
+    LexStats *s = &lx->stats;
+    uint64_t entered = statTick();
+    if (s->leftTick) s->ticks[ST_OUTPUT] += entered - s->leftTick;
+    int more = lexScan(lx, t);
+    uint64_t left = statTick();
+    s->ticks[ST_SCAN] += left - entered;
+    s->leftTick = more ? left : 0;
+    if (more) {
+        s->tokens[t->kind]++;
+        s->tokenBytes[t->kind] += t->text.len;
+    }
+    return more;
+#else
+    return lexScan(lx, t);
+#endif
+}
+
+/* Everything lexer_next() carries from one token to the next. Saving it
+ * and seeking back to it later resumes lexing exactly where it was. */
+typedef struct lexState {
+    size_t pos;
+    size_t lineStart;
+    int row;
+    int prevKeyword;
+    uint32_t scope;
+    int inHeader;
+    int midLine;
+    int brackets;
+} LexState;
+
+static inline LexState lexer_state(const Lexer *lx) {
+    LexState s = { lx->src.pos, lx->lineStart, lx->row, lx->prevKeyword, lx->scope, lx->inHeader,
+                   lx->midLine, lx->brackets };
+    return s;
+}
+
+static inline void lexer_seek(Lexer *lx, LexState s) {
+    lx->src.pos = s.pos;
+    lx->lineStart = s.lineStart;
+    lx->row = s.row;
+    lx->prevKeyword = s.prevKeyword;
+    lx->scope = s.scope;
+    lx->inHeader = s.inHeader;
+    lx->midLine = s.midLine;
+    lx->brackets = s.brackets;
+}
+
+/* Move the lexer onto data[0..len), which holds the input from some point
+ * on, and resume at s, whose offsets are relative to data. Unlike
+ * lexer_reset() this keeps the symbol table: the streaming window
+ * (lexstream.h) slides along the input this way. */
+static inline void lexer_window(Lexer *lx, const char *data, size_t len, LexState s) {
+    lx->src.data = data;
+    lx->src.len = len;
+    lx->limit = len;
+    lexer_seek(lx, s);
+}
+
+/* Forget every symbol, and every scope but the open ones, which are
+ * entered again under new ids. Keeps the table of a lexer that never
+ * stops (lexstream.h) within a bound. Returns 0, or -1 out of memory. */
+static inline int lexer_forget(Lexer *lx) {
+    uint32_t depth = 1;
+    for (uint32_t s = lx->scope; s != lx->globalScope; s = lx->scopes[s].parent) depth++;
+    char **path = malloc(depth * sizeof(char *));
+    if (!path) return -1;
+    uint32_t n = 0;
+    for (uint32_t s = lx->scope; s != lx->globalScope; s = lx->scopes[s].parent)
+        if ((path[n] = strdup(lexScopeName(lx, s))) != NULL) n++;
+    int rc = n == depth - 1 ? 0 : -1;
+
+    poolClear(&lx->names);
+    lx->symbolCount = 0;
+    hiClear(&lx->symbolIndex);
+    lx->scopeCount = 0;
+    hiClear(&lx->scopeIndex);
+    lx->globalScope = lx->scope = lexScopeIn(lx, 0, poolInternString(&lx->names, "Global"));
+    while (n-- > 0) {
+        if (rc == 0) lx->scope = lexScopeIn(lx, lx->scope, poolInternString(&lx->names, path[n]));
+        free(path[n]);
+    }
+    free(path);
+    if (rc != 0) lx->inHeader = 0;
+    return rc;
+}
+
+/* ---------------- STATS ---------------- */
+
+/* Charge the time since `since`, a statTick() reading, to a phase, e.g.
+ * printing a summary after the last token. No-op without -DLEX_STATS. */
+static inline void lexer_stats_charge(Lexer *lx, StatPhase phase, uint64_t since) {
+    LEXSTAT(lx->stats.ticks[phase] += statTick() - since;)
+    (void)lx; (void)phase; (void)since;
+}
+
+/* Charge the time from `since` up to lexer_open() to reading the input. */
+static inline void lexer_stats_input(Lexer *lx, uint64_t since) {
+    LEXSTAT(lx->stats.ticks[ST_INPUT] += lx->stats.startTick - since;)
+    (void)lx; (void)since;
+}
+
+/* Print the phase times and token counts, as text or (json) one JSON line. */
+static inline void lexer_stats_report(const Lexer *lx, FILE *fp, int json) {
+#ifdef LEX_STATS
+    statReport(fp, lx->def->name, &lx->stats, json);
+#else
+    (void)lx; (void)json;
+    fprintf(fp, "lexer stats: not compiled in (build with -DLEX_STATS)\n");
+#endif
+}
+
+static inline void lexer_close(Lexer *lx) {
+    SYMSTAT(lexReport(stderr, lx);)
+    kwFree(&lx->keywords);
+    poolFree(&lx->names);
+    free(lx->symbols);
+    hiFree(&lx->symbolIndex);
+    free(lx->scopes);
+    hiFree(&lx->scopeIndex);
+    memset(lx, 0, sizeof(*lx));
+}
+
+#endif
@@ -0,0 +1,129 @@
+#ifndef LEXINPUT_H
+#define LEXINPUT_H
+
+/* ================= INPUT SOURCE =================
+ * Shared by all the lexers. The whole input is exposed as one contiguous,
+ * read-only buffer: regular files are mmap()ed, anything else (pipes,
+ * terminals) is pulled in with large read() calls. Handlers walk the buffer
+ * with a cursor instead of getc()/ungetc(), and lexemes are views into it.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#define SRC_BLOCK (1 << 20)   /* read() size when the input cannot be mapped */
+
+/* Timing the input (-DLEX_STATS) means faulting it all in up front; otherwise
+ * the page faults land in whatever touches the bytes first. */
+#if defined(LEX_STATS) && defined(MAP_POPULATE)
+#define SRC_MAP_FLAGS (MAP_PRIVATE | MAP_POPULATE)
+#else
+#define SRC_MAP_FLAGS MAP_PRIVATE
+#endif
+
+typedef struct source {
+    const char *data;    // start of the input
+    size_t len;          // number of bytes in data
+    size_t pos;          // cursor: offset of the next unread byte
+    int mapped;          // 1 = data is an mmap, 0 = data is malloc'd (or NULL)
+} Source;
+
+typedef struct lexeme {
+    const char *ptr;     // points into Source.data, not NUL terminated
+    int len;
+} Lexeme;
+
+/* Slurp a non-mappable descriptor in SRC_BLOCK sized reads. */
+static int srcReadAll(Source *s, int fd) {
+    size_t cap = SRC_BLOCK, len = 0;
+    char *buf = malloc(cap);
+    if (!buf) return -1;
+    for (;;) {
+        if (len == cap) {
+            char *bigger = realloc(buf, cap * 2);
+            if (!bigger) { free(buf); return -1; }
+            buf = bigger; cap *= 2;
+        }
+        ssize_t n = read(fd, buf + len, cap - len);
+        if (n < 0) { free(buf); return -1; }
+        if (n == 0) break;
+        len += n;
+    }
+    s->data = buf; s->len = len; s->pos = 0; s->mapped = 0;
+    return 0;
+}
+
+/* Attach a source to an open descriptor; the caller keeps ownership of fd. */
+static int srcOpenFd(Source *s, int fd) {
+    struct stat st;
+    memset(s, 0, sizeof(*s));
+    if (fstat(fd, &st) == 0 && S_ISREG(st.st_mode)) {
+        if (st.st_size == 0) return 0;
+        void *p = mmap(NULL, st.st_size, PROT_READ, SRC_MAP_FLAGS, fd, 0);
+        if (p != MAP_FAILED) {
+            madvise(p, st.st_size, MADV_SEQUENTIAL);
+            s->data = p; s->len = st.st_size; s->mapped = 1;
+            return 0;
+        }
+    }
+    return srcReadAll(s, fd);
+}
+
+static inline int srcOpen(Source *s, const char *path) {
+    int fd = open(path, O_RDONLY);
+    if (fd < 0) return -1;
+    int rc = srcOpenFd(s, fd);
+    close(fd);   // an established mapping outlives the descriptor
+    return rc;
+}
+
+static inline void srcClose(Source *s) {
+    if (s->mapped) munmap((void *)s->data, s->len);
+    else free((void *)s->data);
+    memset(s, 0, sizeof(*s));
+}
+
+/* ---------------- CURSOR ---------------- */
+static inline int srcPeek(const Source *s) {
+    return s->pos < s->len ? (unsigned char)s->data[s->pos] : EOF;
+}
+
+static inline int srcPeekAt(const Source *s, size_t n) {
+    return s->pos + n < s->len ? (unsigned char)s->data[s->pos + n] : EOF;
+}
+
+static inline int srcNext(Source *s) {
+    return s->pos < s->len ? (unsigned char)s->data[s->pos++] : EOF;
+}
+
+static inline void srcAdvance(Source *s, size_t n) {
+    s->pos = s->pos + n < s->len ? s->pos + n : s->len;
+}
+
+static inline const char *srcAt(const Source *s) {
+    return s->data + s->pos;
+}
+
+/* Consume up to and including the next c (or to the end if there is none);
+ * returns a view of the bytes before it. */
+static inline Lexeme srcTakeUntil(Source *s, int c) {
+    Lexeme lx = { s->data + s->pos, 0 };
+    if (s->pos >= s->len) return lx;
+    const char *hit = memchr(lx.ptr, c, s->len - s->pos);
+    lx.len = hit ? (int)(hit - lx.ptr) : (int)(s->len - s->pos);
+    s->pos += lx.len + (hit != NULL);
+    return lx;
+}
+
+/* Move the cursor onto the next '\n' (left unread) or to the end. */
+static inline void srcSkipLine(Source *s) {
+    if (s->pos >= s->len) return;
+    const char *nl = memchr(s->data + s->pos, '\n', s->len - s->pos);
+    s->pos = nl ? (size_t)(nl - s->data) : s->len;
+}
+
+#endif
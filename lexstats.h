@@ -0,0 +1,139 @@
+#ifndef LEXSTATS_H
+#define LEXSTATS_H
+
+/* ================= PHASE TIMERS AND COUNTERS =================
+ * Where a lexer's time goes and what it turns out. Built with -DLEX_STATS,
+ * every Lexer keeps a LexStats: time spent reading input, building tables,
+ * scanning, looking up keywords, entering symbols and, between calls to
+ * lexer_next(), in the caller's output; plus tokens and bytes of each kind,
+ * comments and skipped bytes. Time is read from the TSC on x86 and from
+ * CLOCK_MONOTONIC elsewhere.
+ *
+ * Without -DLEX_STATS, LEXSTAT() statements compile to nothing and
+ * statTick() to 0, so the normal build pays nothing at all.
+ */
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include "token.h"
+
+#ifdef LEX_STATS
+#define LEXSTAT(x) x
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+static inline uint64_t statTick(void) {
+    return __rdtsc();
+}
+#else
+static inline uint64_t statTick(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000000000ull + ts.tv_nsec;
+}
+#endif
+#else
+#define LEXSTAT(x)
+static inline uint64_t statTick(void) {
+    return 0;
+}
+#endif
+
+typedef enum statPhase {
+    ST_INPUT,            // reading the input
+    ST_SETUP,            // lexer_open(): tables
+    ST_SCAN,             // inside lexer_next(), less the two below
+    ST_KEYWORDS,
+    ST_SYMBOLS,
+    ST_OUTPUT,           // the caller, between lexer_next() calls
+    ST_PHASES
+} StatPhase;
+
+static const char *const statPhaseNames[ST_PHASES] = {
+    "input", "setup", "scan", "keywords", "symbols", "output"
+};
+
+typedef struct lexStats {
+    uint64_t ticks[ST_PHASES];     // ST_SCAN still includes keywords and symbols
+    uint64_t tokens[TOK_KIND_COUNT];
+    uint64_t tokenBytes[TOK_KIND_COUNT];
+    uint64_t comments, commentBytes;
+    uint64_t skippedBytes;         // dropped as unknown
+    uint64_t bytes;                // of input
+    uint64_t leftTick;             // when lexer_next() last returned a token; 0 = not since
+    uint64_t startTick, startNs;   // a clock reading each, to convert ticks
+} LexStats;
+
+static inline uint64_t statNanos(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000000000ull + ts.tv_nsec;
+}
+
+static inline void statStart(LexStats *s) {
+    s->startTick = statTick();
+    s->startNs = statNanos();
+}
+
+/* Zero the counts but keep the time, for a lexer that starts over. */
+static inline void statRestart(LexStats *s) {
+    memset(s->tokens, 0, sizeof(s->tokens));
+    memset(s->tokenBytes, 0, sizeof(s->tokenBytes));
+    s->comments = s->commentBytes = s->skippedBytes = 0;
+}
+
+/* Add a helper lexer's counts and work into s; its output time is not s's. */
+static inline void statMerge(LexStats *s, const LexStats *from) {
+    for (int i = ST_SCAN; i <= ST_SYMBOLS; i++) s->ticks[i] += from->ticks[i];
+    for (int i = 0; i < TOK_KIND_COUNT; i++) {
+        s->tokens[i] += from->tokens[i];
+        s->tokenBytes[i] += from->tokenBytes[i];
+    }
+    s->comments += from->comments;
+    s->commentBytes += from->commentBytes;
+    s->skippedBytes += from->skippedBytes;
+}
+
+#ifdef LEX_STATS
+/* Print the report for a lexer of language `lang`, as text or JSON. */
+static void statReport(FILE *fp, const char *lang, const LexStats *s, int json) {
+    uint64_t ticks = statTick() - s->startTick, ns = statNanos() - s->startNs;
+    double msPerTick = ticks ? ns / 1e6 / ticks : 0;
+    double ms[ST_PHASES], total = 0;
+    uint64_t tokens = 0;
+    for (int i = 0; i < ST_PHASES; i++) ms[i] = s->ticks[i] * msPerTick;
+    ms[ST_SCAN] -= ms[ST_KEYWORDS] + ms[ST_SYMBOLS];
+    for (int i = 0; i < ST_PHASES; i++) total += ms[i];
+    for (int i = 0; i < TOK_KIND_COUNT; i++) tokens += s->tokens[i];
+
+    if (json) {
+        fprintf(fp, "{\"lang\": \"%s\", \"bytes\": %llu, \"tokens\": %llu, \"ms\": {", lang,
+                (unsigned long long)s->bytes, (unsigned long long)tokens);
+        for (int i = 0; i < ST_PHASES; i++)
+            fprintf(fp, "%s\"%s\": %.3f", i ? ", " : "", statPhaseNames[i], ms[i]);
+        fprintf(fp, "}, \"kinds\": {");
+        for (int i = 0; i < TOK_KIND_COUNT; i++)
+            fprintf(fp, "%s\"%s\": {\"tokens\": %llu, \"bytes\": %llu}", i ? ", " : "", tokenKindNames[i],
+                    (unsigned long long)s->tokens[i], (unsigned long long)s->tokenBytes[i]);
+        fprintf(fp, "}, \"comments\": %llu, \"commentBytes\": %llu, \"skippedBytes\": %llu}\n",
+                (unsigned long long)s->comments, (unsigned long long)s->commentBytes,
+                (unsigned long long)s->skippedBytes);
+        return;
+    }
+    fprintf(fp, "== lexer stats (%s): %llu bytes, %llu tokens, %.3f ms\n", lang,
+            (unsigned long long)s->bytes, (unsigned long long)tokens, total);
+    for (int i = 0; i < ST_PHASES; i++)
+        fprintf(fp, "%-10s %10.3f ms %5.1f%%\n", statPhaseNames[i], ms[i],
+                total > 0 ? 100 * ms[i] / total : 0.0);
+    for (int i = 0; i < TOK_KIND_COUNT; i++)
+        if (s->tokens[i])
+            fprintf(fp, "%-10s %10llu tokens %10llu bytes\n", tokenKindNames[i],
+                    (unsigned long long)s->tokens[i], (unsigned long long)s->tokenBytes[i]);
+    fprintf(fp, "%-10s %10llu        %10llu bytes\n", "comments",
+            (unsigned long long)s->comments, (unsigned long long)s->commentBytes);
+    if (s->skippedBytes)
+        fprintf(fp, "%-10s %10s        %10llu bytes\n", "skipped", "", (unsigned long long)s->skippedBytes);
+}
+#endif
+
+#endif
@@ -0,0 +1,206 @@
+#ifndef LEXSTREAM_H
+#define LEXSTREAM_H
+
+/* ================= STREAMING INPUT =================
+ * Lexing a descriptor in constant memory: pipes, sockets and files of any
+ * size. The input passes through a window of STREAM_WINDOW bytes which the
+ * lexer sees as its buffer (lexer_window()). When the window runs dry the
+ * bytes already lexed are dropped, the rest moves to the front, and the
+ * free space is filled with the next read().
+ *
+ *   LexStream ls;
+ *   lexer_open(&lx, NULL, 0, LANG_SQL);
+ *   streamOpen(&ls, &lx, STDIN_FILENO, STREAM_WINDOW);
+ *   while (streamNext(&ls, &t))
+ *       ...                        t.text is valid until the next call
+ *   streamClose(&ls);
+ *
+ * A token is handed out only once there are more than STREAM_LOOKAHEAD
+ * bytes after it in the window (or the input has ended), since the
+ * scanner may look that far past a token to end it: a name, a number with
+ * its suffix, an operator. Otherwise the token may be cut short, so the
+ * lexer goes back to where it starts, the window is refilled, and the
+ * token is lexed again. Blanks and whole comments before it are not lexed
+ * again; neither is a run of them up to the end of the window, except for
+ * a comment the window ends inside. Tokens, strings and comments
+ * straddling a refill are therefore whole. One longer than the window
+ * doubles it: memory is bounded by the longest token or comment, with a
+ * layout language's indentation before it, never by the input.
+ *
+ * The lexer defers its symbols (deferSymbols), and streamNext() enters
+ * each token it hands out, so a token lexed twice is entered once. With a
+ * symbol limit, when the table reaches it the stream passes the lexer to
+ * a spill function, which saves the symbols wherever it likes, and then
+ * forgets them (lexer_forget()). A name seen again after that is entered
+ * again as if for the first time: a spilled table may list a name once
+ * per spill, and in a scoped language a name whose outer declaration was
+ * spilled is entered in the scope it is used in.
+ */
+#include <errno.h>
+#include <unistd.h>
+#include "lexer.h"
+#include "outbuf.h"
+
+#define STREAM_WINDOW (1 << 22)   /* default window: 4 MB */
+#define STREAM_LOOKAHEAD 8        /* bytes the scanner may read past a token's end */
+
+typedef void (*SpillFn)(void *arg, const Lexer *lx);
+
+typedef struct lexStream {
+    Lexer *lx;
+    int fd;
+    char *buf;               // the window
+    size_t cap, len;
+    uint64_t dropped;        // input bytes slid out of the window so far
+    int eof;
+    int error;               // errno of a failed read, or ENOMEM
+    uint32_t symbolLimit;    // 0 for no limit
+    SpillFn spill;
+    void *spillArg;
+    uint32_t spills;
+} LexStream;
+
+/* Stream fd through lx, an open lexer, in a window of cap bytes. The
+ * caller keeps ownership of fd. Returns 0, or -1 out of memory. */
+static inline int streamOpen(LexStream *ls, Lexer *lx, int fd, size_t cap) {
+    memset(ls, 0, sizeof(*ls));
+    ls->lx = lx;
+    ls->fd = fd;
+    ls->cap = cap > 2 * STREAM_LOOKAHEAD ? cap : 2 * STREAM_LOOKAHEAD;
+    if (!(ls->buf = malloc(ls->cap))) return -1;
+    lx->deferSymbols = 1;
+    lexer_reset(lx, ls->buf, 0);
+    return 0;
+}
+
+/* Bound the symbol table to limit entries, handing it to spill(arg, lexer)
+ * each time it fills up. */
+static inline void streamSpillAt(LexStream *ls, uint32_t limit, SpillFn spill, void *arg) {
+    ls->symbolLimit = limit;
+    ls->spill = spill;
+    ls->spillArg = arg;
+}
+
+/* Slide the window up to the lexer's cursor, or in a layout language to
+ * the start of the line it is about to begin, and read more behind it.
+ * Returns 0, or -1 with ls->error set. */
+static int streamFill(LexStream *ls) {
+    Lexer *lx = ls->lx;
+    LexState s = lexer_state(lx);
+    size_t from = s.pos;
+    if (lx->def->layout && !s.midLine) from = s.lineStart;    // indent.h measures the line from its start
+    size_t keep = ls->len - from;
+    memmove(ls->buf, ls->buf + from, keep);
+    ls->dropped += from;
+    s.lineStart -= from;    // may wrap below the window: columns are computed modulo 2^64
+    s.pos -= from;
+    ls->len = keep;
+
+    if (ls->len == ls->cap) {    // one token fills the window
+        char *bigger = realloc(ls->buf, ls->cap * 2);
+        if (!bigger) { ls->error = ENOMEM; return -1; }
+        ls->buf = bigger;
+        ls->cap *= 2;
+    }
+    ssize_t n;
+    do n = read(ls->fd, ls->buf + ls->len, ls->cap - ls->len);
+    while (n < 0 && errno == EINTR);
+    if (n < 0) { ls->error = errno; return -1; }
+    if (n == 0) ls->eof = 1;
+    ls->len += n;
+    LEXSTAT(lx->stats.bytes += n;)
+    lexer_window(lx, ls->buf, ls->len, s);
+    return 0;
+}
+
+/* Lexing from before went up to at, where a token starts or the window
+ * ends, and is to be done again after a refill. Go back, but only as far
+ * as the first thing before at that may have been cut short: lex over the
+ * blanks and comments up to it once more with the limit there. */
+static inline void streamRewind(LexStream *ls, LexState before, size_t at) {
+    Lexer *lx = ls->lx;
+    Token skipped;
+    if (lx->cutComment < at) at = lx->cutComment;
+    lexer_seek(lx, before);
+    lx->limit = at;
+    if (lexer_next(lx, &skipped))    // a layout language's NEWLINE at the end of the window
+        lexer_seek(lx, before);
+    lx->limit = ls->len;
+}
+
+/* Fill t with the next token; returns 1, or 0 at the end of the input or
+ * on a read error (ls->error). */
+static inline int streamNext(LexStream *ls, Token *t) {
+    Lexer *lx = ls->lx;
+    for (;;) {
+        LexState before = lexer_state(lx);
+        lx->cutComment = SIZE_MAX;
+        int more = lexer_next(lx, t);
+        if (more && (ls->eof || ls->len - lx->src.pos > STREAM_LOOKAHEAD)) {
+            lexRecord(lx, t);
+            if (ls->symbolLimit && lx->symbolCount >= ls->symbolLimit) {
+                ls->spill(ls->spillArg, lx);
+                if (lexer_forget(lx) != 0) ls->error = ENOMEM;
+                ls->spills++;
+            }
+            return 1;
+        }
+        if (ls->eof) return 0;
+        streamRewind(ls, before, more ? (size_t)(t->text.ptr - t->quotes - ls->buf) : ls->len);
+        if (streamFill(ls) != 0) return 0;
+    }
+}
+
+/* Free the window. The lexer keeps its symbols but no longer has input. */
+static inline void streamClose(LexStream *ls) {
+    LexState s = lexer_state(ls->lx);
+    s.pos = s.lineStart = 0;
+    lexer_window(ls->lx, NULL, 0, s);
+    ls->lx->deferSymbols = 0;
+    free(ls->buf);
+    ls->buf = NULL;
+}
+
+/* ---------------- SPILL FILE ---------------- */
+
+/* Where a command line lexer spills: its own symbol printer writes the
+ * rows to an unlinked temporary file, and spillReplay() copies them out
+ * ahead of the table that is left at the end. */
+typedef struct symbolSpill {
+    FILE *fp;
+    OutBuf out;
+    void (*print)(OutBuf *o, const Lexer *lx);
+} SymbolSpill;
+
+static inline void spillSymbols(void *arg, const Lexer *lx) {
+    SymbolSpill *sp = arg;
+    sp->print(&sp->out, lx);
+}
+
+/* Returns 0, or -1 if no temporary file can be made. */
+static inline int spillOpen(SymbolSpill *sp, void (*print)(OutBuf *o, const Lexer *lx)) {
+    sp->print = print;
+    if (!(sp->fp = tmpfile())) return -1;
+    outOpen(&sp->out, fileno(sp->fp));
+    return 0;
+}
+
+/* Append every spilled row to o; returns 0, or -1 if they cannot be read. */
+static inline int spillReplay(SymbolSpill *sp, OutBuf *o) {
+    char block[1 << 16];
+    ssize_t n;
+    if (outFlush(&sp->out) != 0 || lseek(sp->out.fd, 0, SEEK_SET) != 0) return -1;
+    while ((n = read(sp->out.fd, block, sizeof(block))) != 0) {
+        if (n < 0 && errno == EINTR) continue;
+        if (n < 0) return -1;
+        outBytes(o, block, n);
+    }
+    return 0;
+}
+
+static inline void spillClose(SymbolSpill *sp) {
+    if (sp->fp) fclose(sp->fp);
+    sp->fp = NULL;
+}
+
+#endif
@@ -0,0 +1,102 @@
+#ifndef OUTBUF_H
+#define OUTBUF_H
+
+/* ================= BUFFERED TEXT OUTPUT =================
+ * What the command line tools print tokens and tables through instead of
+ * printf(). An OutBuf is one fixed buffer in front of a descriptor, flushed
+ * with write(). Numbers are formatted by hand, and lexemes are copied
+ * straight out of the input or, when bigger than the buffer, written from
+ * where they are. Nothing is allocated. The text comes out byte for byte
+ * as the printf() formats it replaces would have printed it.
+ *
+ *   static OutBuf out;
+ *   outOpen(&out, STDOUT_FILENO);
+ *   outStr(&out, "<ID,"); outSpan(&out, t.text.ptr, t.text.len); ...
+ *   if (outFlush(&out) != 0) ...
+ *
+ * Don't mix it with stdio on the same descriptor without flushing both.
+ */
+#include <errno.h>
+#include <stdint.h>
+#include <string.h>
+#include <unistd.h>
+
+#define OUT_BUFFER (1 << 16)
+
+typedef struct outBuf {
+    int fd;
+    int failed;            // a write() failed; later output is dropped
+    size_t len;
+    char data[OUT_BUFFER];
+} OutBuf;
+
+static inline void outOpen(OutBuf *o, int fd) {
+    o->fd = fd;
+    o->failed = 0;
+    o->len = 0;
+}
+
+/* write() all of p[0..n), through short writes and signals. */
+static int outWriteAll(OutBuf *o, const char *p, size_t n) {
+    while (n && !o->failed) {
+        ssize_t k = write(o->fd, p, n);
+        if (k < 0 && errno == EINTR) continue;
+        if (k <= 0) { o->failed = 1; break; }
+        p += k;
+        n -= k;
+    }
+    return o->failed ? -1 : 0;
+}
+
+/* Write out what is buffered; -1 if any write so far has failed. */
+static inline int outFlush(OutBuf *o) {
+    size_t n = o->len;
+    o->len = 0;
+    return outWriteAll(o, o->data, n);
+}
+
+static inline void outBytes(OutBuf *o, const char *p, size_t n) {
+    if (n > OUT_BUFFER - o->len) {
+        outFlush(o);
+        if (n >= OUT_BUFFER) { outWriteAll(o, p, n); return; }
+    }
+    memcpy(o->data + o->len, p, n);
+    o->len += n;
+}
+
+static inline void outChar(OutBuf *o, char c) {
+    if (o->len == OUT_BUFFER) outFlush(o);
+    o->data[o->len++] = c;
+}
+
+/* A C string; NULL prints as "(null)", the way glibc's printf("%s") does. */
+static inline void outStr(OutBuf *o, const char *s) {
+    if (!s) s = "(null)";
+    outBytes(o, s, strlen(s));
+}
+
+/* A lexeme, as printf("%.*s") prints it: up to len bytes, stopping at a NUL. */
+static inline void outSpan(OutBuf *o, const char *p, int len) {
+    outBytes(o, p, strnlen(p, len > 0 ? len : 0));
+}
+
+/* s left-justified in width columns, as printf("%-*s"). */
+static inline void outPad(OutBuf *o, const char *s, int width) {
+    if (!s) s = "(null)";
+    size_t n = strlen(s);
+    outBytes(o, s, n);
+    for (; (int)n < width; n++) outChar(o, ' ');
+}
+
+static inline void outU64(OutBuf *o, uint64_t v) {
+    char digits[20], *p = digits + sizeof(digits);
+    do { *--p = '0' + v % 10; v /= 10; } while (v);
+    outBytes(o, p, digits + sizeof(digits) - p);
+}
+
+static inline void outInt(OutBuf *o, int v) {
+    if (v < 0) { outChar(o, '-'); outU64(o, -(int64_t)v); }
+    else outU64(o, v);
+}
+
+#endif
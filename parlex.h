@@ -0,0 +1,173 @@
+#ifndef PARLEX_H
+#define PARLEX_H
+
+/* ================= CHUNK-PARALLEL LEXING =================
+ * Lexes one large buffer on a WorkPool. The input is cut into chunks at
+ * line starts and all of them are lexed at once on the guess that each
+ * starts outside any comment, string or bracket and not after a keyword.
+ * Then, in order, every guess is checked against the state the previous
+ * chunk really ended in; where a comment, string or bracket ran over a cut,
+ * that chunk alone is lexed again from the real state. Symbols are entered
+ * afterwards in token order, so tokens, rows, columns and the symbol table
+ * come out exactly as from lexer_next() on its own.
+ *
+ * A window of chunks is lexed at a time to bound memory. Tokens are pulled
+ * just as with lexer_next():
+ *
+ *   ParLexer pl;
+ *   parOpen(&pl, &lexer, &wp, PAR_CHUNK);
+ *   while (parNext(&pl, &t))
+ *       ...
+ *   parClose(&pl);
+ *
+ * With -DLEX_STATS, the chunks' counts and scanning time are added to the
+ * parent's, so its scan and keyword times are summed over the workers.
+ */
+#include "lexer.h"
+#include "workpool.h"
+
+#define PAR_CHUNK (1 << 20)        // default chunk size in bytes
+#define PAR_CHUNKS_PER_WORKER 4    // window size, per worker
+
+typedef struct lexChunk {
+    Lexer lx;              // copy of the parent sharing its tables; symbols deferred
+    LexState entry;        // state the tokens were lexed from
+    LexState exit;         // state after the last of them
+    Token *tokens;
+    size_t count, cap;
+} LexChunk;
+
+typedef struct parLexer {
+    Lexer *lx;             // tables, symbol table, and the state between windows
+    WorkPool *wp;
+    size_t chunkSize;
+    LexChunk *chunks;
+    int windowSize, chunkCount;
+    int current;           // chunk being handed out
+    size_t next;           // next token in it
+    uint64_t chunksLexed;
+    uint64_t chunksRelexed;  // guessed wrong and lexed again
+} ParLexer;
+
+static void parLexChunk(LexChunk *c) {
+    Token t;
+    c->count = 0;
+    LEXSTAT(statRestart(&c->lx.stats);)    // count a relexed chunk's tokens once
+    lexer_seek(&c->lx, c->entry);
+    while (lexer_next(&c->lx, &t)) {
+        if (c->count == c->cap) {
+            c->cap = c->cap ? c->cap * 2 : 4096;
+            c->tokens = realloc(c->tokens, c->cap * sizeof(Token));
+        }
+        c->tokens[c->count++] = t;
+    }
+    c->exit = lexer_state(&c->lx);
+}
+
+static void parChunkTask(void *arg, int worker) {
+    (void)worker;
+    parLexChunk(arg);
+}
+
+/* Lex the next window of chunks; returns 0 once the input is used up. */
+static int parWindow(ParLexer *pl) {
+    Lexer *lx = pl->lx;
+    const char *data = lx->src.data;
+    size_t len = lx->src.len;
+    LexState real = lexer_state(lx);
+    pl->chunkCount = pl->current = 0;
+    pl->next = 0;
+    if (real.pos >= len) return 0;
+
+    /* Speculative pass. Guessed rows count from 0 at the chunk start. */
+    for (size_t start = real.pos; start < len && pl->chunkCount < pl->windowSize; ) {
+        LexChunk *c = &pl->chunks[pl->chunkCount];
+        size_t end = len;
+        if (len - start > pl->chunkSize) {
+            const char *nl = memchr(data + start + pl->chunkSize, '\n', len - start - pl->chunkSize);
+            if (nl) end = nl + 1 - data;
+        }
+        c->lx = *lx;
+        c->lx.deferSymbols = 1;
+        c->lx.limit = end;
+        LEXSTAT(memset(&c->lx.stats, 0, sizeof(c->lx.stats));)
+        LexState guess = { start, start, 0, -1, real.scope, real.inHeader, 0, 0 };
+        c->entry = pl->chunkCount == 0 ? real : guess;
+        wpSubmit(pl->wp, pl->chunkCount, parChunkTask, c);
+        pl->chunkCount++;
+        start = end;
+    }
+    wpWait(pl->wp);
+
+    /* Check each guess against where the previous chunk really stopped. */
+    for (int i = 1; i < pl->chunkCount; i++) {
+        LexChunk *c = &pl->chunks[i];
+        real = pl->chunks[i - 1].exit;
+        if (real.pos == c->entry.pos && real.prevKeyword == c->entry.prevKeyword &&
+            real.midLine == c->entry.midLine && real.brackets == c->entry.brackets) {
+            for (size_t k = 0; k < c->count; k++) c->tokens[k].row += real.row;
+            c->exit.row += real.row;
+        } else {
+            c->entry = real;
+            parLexChunk(c);
+            pl->chunksRelexed++;
+        }
+    }
+    pl->chunksLexed += pl->chunkCount;
+    LEXSTAT(for (int i = 0; i < pl->chunkCount; i++) statMerge(&lx->stats, &pl->chunks[i].lx.stats);)
+
+    /* Symbols, in token order; the parent carries the scope across windows. */
+    uint32_t scope = lx->scope;
+    int inHeader = lx->inHeader;
+    lexer_seek(lx, pl->chunks[pl->chunkCount - 1].exit);
+    lx->scope = scope;
+    lx->inHeader = inHeader;
+    LEXSTAT(uint64_t replay = statTick();)
+    for (int i = 0; !lx->deferSymbols && i < pl->chunkCount; i++)
+        for (size_t k = 0; k < pl->chunks[i].count; k++)
+            lexRecord(lx, &pl->chunks[i].tokens[k]);
+    LEXSTAT(lx->stats.ticks[ST_SCAN] += statTick() - replay;)    // holds ST_SYMBOLS
+    return 1;
+}
+
+/* Lex lx's buffer from its current state, chunkSize bytes per chunk. */
+static inline void parOpen(ParLexer *pl, Lexer *lx, WorkPool *wp, size_t chunkSize) {
+    memset(pl, 0, sizeof(*pl));
+    pl->lx = lx;
+    pl->wp = wp;
+    pl->chunkSize = chunkSize ? chunkSize : PAR_CHUNK;
+    pl->windowSize = wp->workers * PAR_CHUNKS_PER_WORKER;
+    pl->chunks = calloc(pl->windowSize, sizeof(LexChunk));
+}
+
+/* Same contract as lexer_next(). */
+static int parNext(ParLexer *pl, Token *t) {
+#ifdef LEX_STATS
+    LexStats *s = &pl->lx->stats;
+    if (s->leftTick) s->ticks[ST_OUTPUT] += statTick() - s->leftTick;
+    s->leftTick = 0;
+#endif
+    for (;;) {
+        if (pl->current < pl->chunkCount) {
+            LexChunk *c = &pl->chunks[pl->current];
+            if (pl->next < c->count) {
+                *t = c->tokens[pl->next++];
+                LEXSTAT(s->leftTick = statTick();)
+                return 1;
+            }
+            pl->current++;
+            pl->next = 0;
+        } else if (!parWindow(pl)) {
+            return lexer_next(pl->lx, t);    // the TOK_EOF token
+        }
+    }
+}
+
+static inline void parClose(ParLexer *pl) {
+    for (int i = 0; i < pl->windowSize; i++)
+        free(pl->chunks[i].tokens);
+    free(pl->chunks);
+    memset(pl, 0, sizeof(*pl));
+}
+
+#endif
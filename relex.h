@@ -0,0 +1,360 @@
+#ifndef RELEX_H
+#define RELEX_H
+
+/* ================= INCREMENTAL RE-LEXING =================
+ * Keeps the tokens and symbols of a buffer under edit and, after each edit,
+ * lexes again only around it. Before the first token of every line the
+ * lexer's state (position, row, previous keyword, current scope) is saved
+ * as a checkpoint. Comments and strings are single tokens, so a checkpoint
+ * is never inside one. An edit restarts the lexer at the last checkpoint
+ * before it and stops at the first checkpoint past the edit whose saved
+ * state the lexer reproduces: from there on the old tokens still hold,
+ * only moved.
+ *
+ * Tokens and checkpoints live in gap arrays split where the last edit was.
+ * Entries after the gap count bytes, rows and tokens from the end of the
+ * text, so an edit leaves them alone; moving the gap costs the distance
+ * from the previous edit.
+ *
+ * Symbols are reference counted by the tokens that entered them and
+ * retracted when the last of those goes, so the live symbols are always
+ * those of the current text. A symbol named by both a function and an
+ * identifier token reads as a function.
+ *
+ * In a scoped language an identifier resolves to whatever entry of its
+ * name was open when it was lexed. Tokens past the relexed stretch keep
+ * theirs, so after an edit that adds or removes a name in an outer scope
+ * the table can differ from a fresh lex's in which entries those uses
+ * hold; the tokens and scopes themselves always match.
+ *
+ *   IncLexer d;
+ *   incOpen(&d, text, len, LANG_C);
+ *   incEdit(&d, start, removed, "replacement", 11);
+ *   for (size_t i = 0; i < incTokenCount(&d); i++)
+ *       incToken(&d, i, &t);
+ *   incClose(&d);
+ */
+#include "lexer.h"
+
+#define INC_COMPACT_MIN 1024       // retracted symbols kept before compacting
+
+typedef struct incToken {
+    TokenKind kind;
+    int keyword;
+    size_t start;          // after the gap: bytes before the end of the text
+    int len;
+    int row;               // after the gap: rows before the last row
+    int col;
+    int quotes;
+    NumberValue number;
+    int symbol;            // entry it holds in lx.symbols, -1 if none
+} IncToken;
+
+typedef struct incCheckpoint {
+    LexState state;        // after the gap: pos, lineStart and row as for tokens
+    size_t token;          // first token lexed from it; after the gap, from the end
+} IncCheckpoint;
+
+typedef struct incUses {
+    uint32_t idents, funcs;    // tokens holding the symbol, by kind
+} IncUses;
+
+typedef struct incLexer {
+    Lexer lx;              // tables and symbol table; symbols deferred
+    char *text;
+    size_t len, cap;
+    int lastRow;           // row at the end of the text
+    IncToken *tokens;      // live: [0, tokenLo) and [tokenHi, tokenCap)
+    size_t tokenLo, tokenHi, tokenCap;
+    IncCheckpoint *checks; // live: [0, checkLo) and [checkHi, checkCap)
+    size_t checkLo, checkHi, checkCap;
+    IncUses *uses;         // per symbol entry; none = retracted
+    uint32_t usesCap, deadSymbols;
+    uint64_t tokensLexed;  // by every lex so far, the first included
+} IncLexer;
+
+/* ---------------- GAP ARRAYS ---------------- */
+static inline size_t incTokenCount(const IncLexer *d) {
+    return d->tokenLo + (d->tokenCap - d->tokenHi);
+}
+
+static inline size_t incCheckCount(const IncLexer *d) {
+    return d->checkLo + (d->checkCap - d->checkHi);
+}
+
+/* Switch an entry between absolute and from-the-end; its own inverse. */
+static inline void incFlipToken(const IncLexer *d, IncToken *t) {
+    t->start = d->len - t->start;
+    t->row = d->lastRow - t->row;
+}
+
+static inline void incFlipCheck(const IncLexer *d, IncCheckpoint *c) {
+    c->state.pos = d->len - c->state.pos;
+    c->state.lineStart = d->len - c->state.lineStart;
+    c->state.row = d->lastRow - c->state.row;
+    c->token = incTokenCount(d) - c->token;
+}
+
+static inline IncToken incTokenAt(const IncLexer *d, size_t i) {
+    if (i < d->tokenLo) return d->tokens[i];
+    IncToken t = d->tokens[d->tokenHi + (i - d->tokenLo)];
+    incFlipToken(d, &t);
+    return t;
+}
+
+static inline IncCheckpoint incCheckAt(const IncLexer *d, size_t i) {
+    if (i < d->checkLo) return d->checks[i];
+    IncCheckpoint c = d->checks[d->checkHi + (i - d->checkLo)];
+    incFlipCheck(d, &c);
+    return c;
+}
+
+static void incMoveTokenGap(IncLexer *d, size_t at) {
+    while (d->tokenLo > at) {
+        d->tokens[--d->tokenHi] = d->tokens[--d->tokenLo];
+        incFlipToken(d, &d->tokens[d->tokenHi]);
+    }
+    while (d->tokenLo < at) {
+        d->tokens[d->tokenLo] = d->tokens[d->tokenHi++];
+        incFlipToken(d, &d->tokens[d->tokenLo++]);
+    }
+}
+
+static void incMoveCheckGap(IncLexer *d, size_t at) {
+    while (d->checkLo > at) {
+        d->checks[--d->checkHi] = d->checks[--d->checkLo];
+        incFlipCheck(d, &d->checks[d->checkHi]);
+    }
+    while (d->checkLo < at) {
+        d->checks[d->checkLo] = d->checks[d->checkHi++];
+        incFlipCheck(d, &d->checks[d->checkLo++]);
+    }
+}
+
+static void incPushCheck(IncLexer *d, LexState s) {
+    if (d->checkLo == d->checkHi) {
+        size_t tail = d->checkCap - d->checkHi, cap = d->checkCap ? d->checkCap * 2 : 256;
+        d->checks = realloc(d->checks, cap * sizeof(IncCheckpoint));
+        memmove(d->checks + cap - tail, d->checks + d->checkHi, tail * sizeof(IncCheckpoint));
+        d->checkHi = cap - tail;
+        d->checkCap = cap;
+    }
+    IncCheckpoint c = { s, d->tokenLo };
+    d->checks[d->checkLo++] = c;
+}
+
+/* ---------------- SYMBOLS ---------------- */
+static inline int incSymbolLive(const IncLexer *d, uint32_t entry) {
+    return d->uses[entry].idents + d->uses[entry].funcs > 0;
+}
+
+static void incHold(IncLexer *d, const IncToken *t, int delta) {
+    IncUses *u = &d->uses[t->symbol];
+    int was = incSymbolLive(d, t->symbol);
+    if (t->kind == TOK_FUNC) u->funcs += delta;
+    else u->idents += delta;
+    d->deadSymbols += was - incSymbolLive(d, t->symbol);
+    d->lx.symbols[t->symbol].type = u->funcs ? SYM_FUNC : SYM_IDENTIFIER;
+}
+
+static void incPushToken(IncLexer *d, const Token *t) {
+    Lexer *lx = &d->lx;
+    if (d->tokenLo == d->tokenHi) {
+        size_t tail = d->tokenCap - d->tokenHi, cap = d->tokenCap ? d->tokenCap * 2 : 1024;
+        d->tokens = realloc(d->tokens, cap * sizeof(IncToken));
+        memmove(d->tokens + cap - tail, d->tokens + d->tokenHi, tail * sizeof(IncToken));
+        d->tokenHi = cap - tail;
+        d->tokenCap = cap;
+    }
+    IncToken *it = &d->tokens[d->tokenLo++];
+    it->kind = t->kind;
+    it->keyword = t->keyword;
+    it->start = t->text.ptr - d->text;
+    it->len = t->text.len;
+    it->row = t->row;
+    it->col = t->col;
+    it->quotes = t->quotes;
+    it->number = t->number;
+    uint32_t before = lx->symbolCount;
+    it->symbol = lexRecord(lx, t);
+    if (it->symbol < 0) return;
+    if (lx->symbolCount > d->usesCap) {
+        uint32_t cap = lx->symbolCap;
+        d->uses = realloc(d->uses, cap * sizeof(IncUses));
+        memset(d->uses + d->usesCap, 0, (cap - d->usesCap) * sizeof(IncUses));
+        d->usesCap = cap;
+    }
+    if (lx->symbolCount > before) d->deadSymbols++;   // new, and about to be held
+    incHold(d, it, 1);
+}
+
+/* Drop the first n tokens after the gap and what they held. */
+static void incDropTokens(IncLexer *d, size_t n) {
+    for (; n > 0; n--, d->tokenHi++)
+        if (d->tokens[d->tokenHi].symbol >= 0) incHold(d, &d->tokens[d->tokenHi], -1);
+}
+
+static uint32_t incRename(StringPool *to, uint32_t *map, const StringPool *from, uint32_t id) {
+    if (map[id] == UINT32_MAX)
+        map[id] = poolIntern(to, poolString(from, id), poolLength(from, id));
+    return map[id];
+}
+
+/* Squeeze retracted symbols, and names nothing uses any more, out of the
+ * table, renumbering whatever refers to the rest. */
+static void incCompact(IncLexer *d) {
+    Lexer *lx = &d->lx;
+    StringPool names;
+    memset(&names, 0, sizeof(names));
+    uint32_t *nameMap = malloc(lx->names.count * sizeof(uint32_t));
+    uint32_t *symbolMap = malloc(lx->symbolCount * sizeof(uint32_t));
+    memset(nameMap, 0xff, lx->names.count * sizeof(uint32_t));
+
+    hiClear(&lx->scopeIndex);
+    for (uint32_t i = 0; i < lx->scopeCount; i++) {    // ids stay: checkpoints hold them
+        LexScope *s = &lx->scopes[i];
+        s->name = incRename(&names, nameMap, &lx->names, s->name);
+        hiInsert(&lx->scopeIndex, lexSymbolHash(s->name, s->parent), i);
+    }
+    hiClear(&lx->symbolIndex);
+    uint32_t live = 0;
+    for (uint32_t i = 0; i < lx->symbolCount; i++) {
+        if (!incSymbolLive(d, i)) continue;
+        Symbol s = lx->symbols[i];
+        s.name = incRename(&names, nameMap, &lx->names, s.name);
+        lx->symbols[live] = s;
+        d->uses[live] = d->uses[i];
+        hiInsert(&lx->symbolIndex, lexSymbolHash(s.name, s.scope), live);
+        symbolMap[i] = live++;
+    }
+    memset(d->uses + live, 0, (d->usesCap - live) * sizeof(IncUses));
+    lx->symbolCount = live;
+    d->deadSymbols = 0;
+
+    for (size_t i = 0; i < d->tokenCap; i++)
+        if ((i < d->tokenLo || i >= d->tokenHi) && d->tokens[i].symbol >= 0)
+            d->tokens[i].symbol = symbolMap[d->tokens[i].symbol];
+    poolFree(&lx->names);
+    lx->names = names;
+    free(nameMap);
+    free(symbolMap);
+}
+
+/* ---------------- LEXING ---------------- */
+
+/* Lex on from the last checkpoint before the gap until the lexer is back
+ * in a state saved after the gap at or past editEnd, or the text ends. */
+static void incRelex(IncLexer *d, size_t editEnd) {
+    Lexer *lx = &d->lx;
+    int row = -1;      // of the previous token; none yet
+    Token t;
+    lexer_seek(lx, d->checks[d->checkLo - 1].state);
+    for (;;) {
+        LexState s = lexer_state(lx);
+        if (!lexer_next(lx, &t)) break;
+        d->tokensLexed++;
+        if (row >= 0 && t.row != row) {
+            while (s.pos >= editEnd && d->checkHi < d->checkCap) {
+                IncCheckpoint old = incCheckAt(d, d->checkLo);
+                if (old.state.pos > s.pos) break;
+                size_t tail = d->checks[d->checkHi++].token;
+                if (old.state.pos == s.pos && old.state.lineStart == s.lineStart &&
+                    old.state.row == s.row && old.state.prevKeyword == s.prevKeyword &&
+                    old.state.scope == s.scope && old.state.inHeader == s.inHeader &&
+                    old.state.midLine == s.midLine && old.state.brackets == s.brackets) {
+                    incDropTokens(d, (d->tokenCap - d->tokenHi) - tail);
+                    incPushCheck(d, s);
+                    return;
+                }
+            }
+            incPushCheck(d, s);
+        }
+        row = t.row;
+        incPushToken(d, &t);
+    }
+    incDropTokens(d, d->tokenCap - d->tokenHi);
+    d->checkHi = d->checkCap;
+    d->lastRow = t.row;
+}
+
+/* ---------------- API ---------------- */
+
+/* Copy text[0..len) and lex it as lang. Returns 0, or -1 if the language's
+ * tables cannot be built. */
+static int incOpen(IncLexer *d, const char *text, size_t len, Language lang) {
+    memset(d, 0, sizeof(*d));
+    if (lexer_open(&d->lx, NULL, 0, lang) != 0) return -1;
+    d->lx.deferSymbols = 1;
+    d->cap = len ? len : 1;
+    d->text = malloc(d->cap);
+    memcpy(d->text, text, len);
+    d->len = len;
+    lexer_reset(&d->lx, d->text, d->len);
+    incPushCheck(d, lexer_state(&d->lx));
+    incRelex(d, 0);
+    return 0;
+}
+
+/* Replace text[start, start+removed) with ins[0..insLen) and bring tokens
+ * and symbols up to date. Returns 0, or -1 if the range is not in the text. */
+static int incEdit(IncLexer *d, size_t start, size_t removed, const char *ins, size_t insLen) {
+    if (start > d->len || removed > d->len - start) return -1;
+    size_t end = start + removed;
+
+    /* Restart at the last checkpoint strictly before the edit: the token
+     * before a checkpoint may have looked at the byte it stops at. */
+    size_t lo = 1, hi = incCheckCount(d);
+    while (lo < hi) {
+        size_t mid = (lo + hi) / 2;
+        if (incCheckAt(d, mid).state.pos < start) lo = mid + 1;
+        else hi = mid;
+    }
+    incMoveCheckGap(d, lo);
+    incMoveTokenGap(d, d->checks[lo - 1].token);
+    while (d->checkHi < d->checkCap && incCheckAt(d, d->checkLo).state.pos < end)
+        d->checkHi++;   // inside the replaced text: cannot come back
+
+    int rows = 0;
+    for (size_t i = start; i < end; i++) rows -= d->text[i] == '\n';
+    for (size_t i = 0; i < insLen; i++) rows += ins[i] == '\n';
+    size_t len = d->len - removed + insLen;
+    if (len > d->cap) {
+        while (len > d->cap) d->cap *= 2;
+        d->text = realloc(d->text, d->cap);
+    }
+    memmove(d->text + start + insLen, d->text + end, d->len - end);
+    memcpy(d->text + start, ins, insLen);
+    d->len = len;
+    d->lastRow += rows;
+    d->lx.src.data = d->text;
+    d->lx.src.len = d->lx.limit = len;
+
+    incRelex(d, start + insLen);
+    if (d->deadSymbols > INC_COMPACT_MIN && d->deadSymbols > d->lx.symbolCount / 2)
+        incCompact(d);
+    return 0;
+}
+
+/* Token i, pointing into the current text. */
+static inline void incToken(const IncLexer *d, size_t i, Token *t) {
+    IncToken it = incTokenAt(d, i);
+    t->kind = it.kind;
+    t->text.ptr = d->text + it.start;
+    t->text.len = it.len;
+    t->row = it.row;
+    t->col = it.col;
+    t->keyword = it.keyword;
+    t->quotes = it.quotes;
+    t->number = it.number;
+}
+
+static inline void incClose(IncLexer *d) {
+    lexer_close(&d->lx);
+    free(d->text);
+    free(d->tokens);
+    free(d->checks);
+    free(d->uses);
+    memset(d, 0, sizeof(*d));
+}
+
+#endif
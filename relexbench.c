@@ -0,0 +1,94 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "relex.h"
+
+/* Incremental re-lexing benchmark: replays random keystrokes (typing and
+ * deleting characters, opening and closing lines) against a file and times
+ * each edit against lexing the whole file again. The cursor moves on as it
+ * types and now and then jumps somewhere else, as in an editor. The final
+ * tokens are checked against a full lex of the edited text.
+ *
+ *   cc -O2 relexbench.c -o relexbench && ./relexbench file [edits]
+ */
+
+#define DEFAULT_EDITS 10000
+#define JUMP_PERCENT 1
+
+double now() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+/* Keystrokes: mostly identifier characters, some punctuation and lines. */
+const char *keys[] = { "a", "x", "_", "1", " ", "(", ")", ";", ",", "\n", "\n    " };
+
+/* 0 if d's tokens are what lexing its text from scratch gives. */
+int compareFull(const IncLexer *d, Language lang) {
+    Lexer lx;
+    Token t, u;
+    size_t i = 0;
+    int bad = 0;
+    lexer_open(&lx, d->text, d->len, lang);
+    while (!bad && lexer_next(&lx, &t)) {
+        if (i >= incTokenCount(d)) { bad = 1; break; }
+        incToken(d, i++, &u);
+        bad = t.kind != u.kind || t.text.ptr != u.text.ptr || t.text.len != u.text.len ||
+              t.row != u.row || t.col != u.col;
+    }
+    if (i != incTokenCount(d)) bad = 1;
+    lexer_close(&lx);
+    return bad;
+}
+
+int main(int argc, char **argv) {
+    if (argc < 2) {
+        printf("usage: %s file [edits]\n", argv[0]);
+        return 1;
+    }
+    int edits = argc > 2 ? atoi(argv[2]) : DEFAULT_EDITS;
+    int lang = languageForPath(argv[1]);
+    Source src;
+    if (lang < 0) { printf("%s: unknown extension\n", argv[1]); return 1; }
+    if (srcOpen(&src, argv[1]) != 0) { printf("Cannot open %s\n", argv[1]); return 1; }
+
+    IncLexer d;
+    double t0 = now();
+    if (incOpen(&d, src.data, src.len, lang) != 0) { printf("Cannot build keyword table\n"); return 1; }
+    double full = now() - t0;
+    uint64_t lexed = d.tokensLexed;
+    printf("%s: %zu bytes, %zu tokens, full lex %.3f ms\n",
+           argv[1], src.len, incTokenCount(&d), full * 1e3);
+
+    unsigned state = 12345;
+    size_t at = d.len / 2;
+    double worst = 0, total = 0;
+    for (int i = 0; i < edits; i++) {
+        state = state * 1103515245 + 12345;
+        if ((state >> 16) % 100 < JUMP_PERCENT) at = d.len ? (state >> 8) % d.len : 0;
+        const char *key = keys[(state >> 4) % (sizeof(keys) / sizeof(keys[0]))];
+        int erase = (state & 3) == 0 && at > 0;
+        t0 = now();
+        if (erase) {
+            incEdit(&d, --at, 1, "", 0);
+        } else {
+            incEdit(&d, at, 0, key, strlen(key));
+            at += strlen(key);
+        }
+        double t = now() - t0;
+        total += t;
+        if (t > worst) worst = t;
+    }
+    printf("%d edits: mean %.2f us, worst %.2f us, %.1f tokens lexed per edit (%.0fx faster than a full lex)\n",
+           edits, total / edits * 1e6, worst * 1e6, (double)(d.tokensLexed - lexed) / edits,
+           total > 0 ? full * edits / total : 0);
+    printf("%u symbols, %u retracted\n", d.lx.symbolCount - d.deadSymbols, d.deadSymbols);
+
+    int bad = compareFull(&d, lang);
+    printf("%s\n", bad ? "MISMATCH against a full lex" : "tokens match a full lex");
+    incClose(&d);
+    srcClose(&src);
+    return bad;
+}
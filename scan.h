@@ -0,0 +1,225 @@
+#ifndef SCAN_H
+#define SCAN_H
+
+/* ================= SCAN KERNELS =================
+ * Vector versions of the lexer's hottest loops: skipping a run of blanks,
+ * finding the end of an identifier, finding a two-byte terminator such as
+ * the end of a block comment, and marking the bytes of a small set in a
+ * 64-byte block, such as the quotes, commas and parentheses of an SQL
+ * VALUES tuple (sqlvalues.h). Each comes as scalar, SSE2 and AVX2 code and
+ * scanSelect() picks the widest one the CPU supports. The vector loops
+ * never load past `end`; a final partial block is finished by the scalar
+ * code.
+ *
+ * Single-byte terminators (end of line, closing quote) are left to memchr,
+ * which the C library already vectorises.
+ *
+ * LEX_SCAN=scalar|sse2|avx2 in the environment forces a narrower kernel,
+ * for comparing them.
+ */
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define SCAN_SET_MAX 8    // bytes maskAny() looks for at once
+
+#if defined(__x86_64__) || (defined(__i386__) && defined(__SSE2__))
+#include <immintrin.h>
+#define SCAN_X86 1
+#endif
+
+typedef struct scanKernels {
+    const char *name;
+    const char *(*skipBlanks)(const char *p, const char *end);  // past ' ' \t \v \f \r
+    const char *(*wordEnd)(const char *p, const char *end);     // past [A-Za-z0-9_]
+    const char *(*findPair)(const char *p, const char *end, char a, char b);  // NULL if absent
+    uint64_t (*maskAny)(const char *p, const char *end, const char *set);    // bit i: p[i] in set
+} ScanKernels;
+
+/* ---------------- SCALAR ---------------- */
+static inline int scanIsBlank(unsigned char c) {
+    return c == ' ' || (c >= '\t' && c <= '\r' && c != '\n');
+}
+
+static inline int scanIsWord(unsigned char c) {
+    return (unsigned)((c | 0x20) - 'a') < 26 || (unsigned)(c - '0') < 10 || c == '_';
+}
+
+static const char *scanSkipBlanksScalar(const char *p, const char *end) {
+    while (p < end && scanIsBlank(*p)) p++;
+    return p;
+}
+
+static const char *scanWordEndScalar(const char *p, const char *end) {
+    while (p < end && scanIsWord(*p)) p++;
+    return p;
+}
+
+static const char *scanFindPairScalar(const char *p, const char *end, char a, char b) {
+    while (end - p >= 2 && (p = memchr(p, a, end - p - 1)) != NULL) {
+        if (p[1] == b) return p;
+        p++;
+    }
+    return NULL;
+}
+
+/* Mark the bytes of [p, end), up to 64 of them, found in set, a string of
+ * at most SCAN_SET_MAX bytes. */
+static uint64_t scanMaskAnyScalar(const char *p, const char *end, const char *set) {
+    uint64_t in[4] = { 0, 0, 0, 0 }, mask = 0;
+    for (; *set; set++) in[(uint8_t)*set >> 6] |= 1ull << (*set & 63);
+    int n = end - p < 64 ? (int)(end - p) : 64;
+    for (int i = 0; i < n; i++) {
+        uint8_t c = (uint8_t)p[i];
+        mask |= (in[c >> 6] >> (c & 63) & 1) << i;
+    }
+    return mask;
+}
+
+static const ScanKernels scanScalar = {
+    "scalar", scanSkipBlanksScalar, scanWordEndScalar, scanFindPairScalar, scanMaskAnyScalar
+};
+
+#ifdef SCAN_X86
+/* ---------------- SSE2 ----------------
+ * Byte ranges are tested with signed compares, so bytes >= 0x80 (negative)
+ * never fall inside an ASCII range.
+ */
+static const char *scanSkipBlanksSSE2(const char *p, const char *end) {
+    const __m128i space = _mm_set1_epi8(' '), nl = _mm_set1_epi8('\n');
+    const __m128i lo = _mm_set1_epi8('\t' - 1), hi = _mm_set1_epi8('\r' + 1);
+    for (; end - p >= 16; p += 16) {
+        __m128i v = _mm_loadu_si128((const __m128i *)p);
+        __m128i ctl = _mm_and_si128(_mm_cmpgt_epi8(v, lo), _mm_cmplt_epi8(v, hi));
+        __m128i blank = _mm_or_si128(_mm_cmpeq_epi8(v, space),
+                                     _mm_andnot_si128(_mm_cmpeq_epi8(v, nl), ctl));
+        unsigned miss = ~_mm_movemask_epi8(blank) & 0xffff;
+        if (miss) return p + __builtin_ctz(miss);
+    }
+    return scanSkipBlanksScalar(p, end);
+}
+
+static const char *scanWordEndSSE2(const char *p, const char *end) {
+    const __m128i case20 = _mm_set1_epi8(0x20), under = _mm_set1_epi8('_');
+    const __m128i aLo = _mm_set1_epi8('a' - 1), aHi = _mm_set1_epi8('z' + 1);
+    const __m128i dLo = _mm_set1_epi8('0' - 1), dHi = _mm_set1_epi8('9' + 1);
+    for (; end - p >= 16; p += 16) {
+        __m128i v = _mm_loadu_si128((const __m128i *)p);
+        __m128i lower = _mm_or_si128(v, case20);
+        __m128i alpha = _mm_and_si128(_mm_cmpgt_epi8(lower, aLo), _mm_cmplt_epi8(lower, aHi));
+        __m128i digit = _mm_and_si128(_mm_cmpgt_epi8(v, dLo), _mm_cmplt_epi8(v, dHi));
+        __m128i word = _mm_or_si128(_mm_or_si128(alpha, digit), _mm_cmpeq_epi8(v, under));
+        unsigned miss = ~_mm_movemask_epi8(word) & 0xffff;
+        if (miss) return p + __builtin_ctz(miss);
+    }
+    return scanWordEndScalar(p, end);
+}
+
+static const char *scanFindPairSSE2(const char *p, const char *end, char a, char b) {
+    const __m128i va = _mm_set1_epi8(a), vb = _mm_set1_epi8(b);
+    for (; end - p >= 17; p += 16) {
+        __m128i first = _mm_cmpeq_epi8(_mm_loadu_si128((const __m128i *)p), va);
+        __m128i second = _mm_cmpeq_epi8(_mm_loadu_si128((const __m128i *)(p + 1)), vb);
+        unsigned hit = _mm_movemask_epi8(_mm_and_si128(first, second));
+        if (hit) return p + __builtin_ctz(hit);
+    }
+    return scanFindPairScalar(p, end, a, b);
+}
+
+static uint64_t scanMaskAnySSE2(const char *p, const char *end, const char *set) {
+    if (end - p < 64) return scanMaskAnyScalar(p, end, set);
+    __m128i want[SCAN_SET_MAX];
+    int n = 0;
+    while (n < SCAN_SET_MAX && set[n]) { want[n] = _mm_set1_epi8(set[n]); n++; }
+    uint64_t mask = 0;
+    for (int k = 0; k < 64; k += 16) {
+        __m128i v = _mm_loadu_si128((const __m128i *)(p + k)), any = _mm_cmpeq_epi8(v, want[0]);
+        for (int i = 1; i < n; i++) any = _mm_or_si128(any, _mm_cmpeq_epi8(v, want[i]));
+        mask |= (uint64_t)_mm_movemask_epi8(any) << k;
+    }
+    return mask;
+}
+
+static const ScanKernels scanSSE2 = {
+    "sse2", scanSkipBlanksSSE2, scanWordEndSSE2, scanFindPairSSE2, scanMaskAnySSE2
+};
+
+/* ---------------- AVX2 ---------------- */
+__attribute__((target("avx2")))
+static const char *scanSkipBlanksAVX2(const char *p, const char *end) {
+    const __m256i space = _mm256_set1_epi8(' '), nl = _mm256_set1_epi8('\n');
+    const __m256i lo = _mm256_set1_epi8('\t' - 1), hi = _mm256_set1_epi8('\r' + 1);
+    for (; end - p >= 32; p += 32) {
+        __m256i v = _mm256_loadu_si256((const __m256i *)p);
+        __m256i ctl = _mm256_and_si256(_mm256_cmpgt_epi8(v, lo), _mm256_cmpgt_epi8(hi, v));
+        __m256i blank = _mm256_or_si256(_mm256_cmpeq_epi8(v, space),
+                                        _mm256_andnot_si256(_mm256_cmpeq_epi8(v, nl), ctl));
+        unsigned miss = ~(unsigned)_mm256_movemask_epi8(blank);
+        if (miss) return p + __builtin_ctz(miss);
+    }
+    return scanSkipBlanksSSE2(p, end);
+}
+
+__attribute__((target("avx2")))
+static const char *scanWordEndAVX2(const char *p, const char *end) {
+    const __m256i case20 = _mm256_set1_epi8(0x20), under = _mm256_set1_epi8('_');
+    const __m256i aLo = _mm256_set1_epi8('a' - 1), aHi = _mm256_set1_epi8('z' + 1);
+    const __m256i dLo = _mm256_set1_epi8('0' - 1), dHi = _mm256_set1_epi8('9' + 1);
+    for (; end - p >= 32; p += 32) {
+        __m256i v = _mm256_loadu_si256((const __m256i *)p);
+        __m256i lower = _mm256_or_si256(v, case20);
+        __m256i alpha = _mm256_and_si256(_mm256_cmpgt_epi8(lower, aLo), _mm256_cmpgt_epi8(aHi, lower));
+        __m256i digit = _mm256_and_si256(_mm256_cmpgt_epi8(v, dLo), _mm256_cmpgt_epi8(dHi, v));
+        __m256i word = _mm256_or_si256(_mm256_or_si256(alpha, digit), _mm256_cmpeq_epi8(v, under));
+        unsigned miss = ~(unsigned)_mm256_movemask_epi8(word);
+        if (miss) return p + __builtin_ctz(miss);
+    }
+    return scanWordEndSSE2(p, end);
+}
+
+__attribute__((target("avx2")))
+static const char *scanFindPairAVX2(const char *p, const char *end, char a, char b) {
+    const __m256i va = _mm256_set1_epi8(a), vb = _mm256_set1_epi8(b);
+    for (; end - p >= 33; p += 32) {
+        __m256i first = _mm256_cmpeq_epi8(_mm256_loadu_si256((const __m256i *)p), va);
+        __m256i second = _mm256_cmpeq_epi8(_mm256_loadu_si256((const __m256i *)(p + 1)), vb);
+        unsigned hit = (unsigned)_mm256_movemask_epi8(_mm256_and_si256(first, second));
+        if (hit) return p + __builtin_ctz(hit);
+    }
+    return scanFindPairSSE2(p, end, a, b);
+}
+
+__attribute__((target("avx2")))
+static uint64_t scanMaskAnyAVX2(const char *p, const char *end, const char *set) {
+    if (end - p < 64) return scanMaskAnyScalar(p, end, set);
+    __m256i want[SCAN_SET_MAX];
+    int n = 0;
+    while (n < SCAN_SET_MAX && set[n]) { want[n] = _mm256_set1_epi8(set[n]); n++; }
+    uint64_t mask = 0;
+    for (int k = 0; k < 64; k += 32) {
+        __m256i v = _mm256_loadu_si256((const __m256i *)(p + k)), any = _mm256_cmpeq_epi8(v, want[0]);
+        for (int i = 1; i < n; i++) any = _mm256_or_si256(any, _mm256_cmpeq_epi8(v, want[i]));
+        mask |= (uint64_t)(unsigned)_mm256_movemask_epi8(any) << k;
+    }
+    return mask;
+}
+
+static const ScanKernels scanAVX2 = {
+    "avx2", scanSkipBlanksAVX2, scanWordEndAVX2, scanFindPairAVX2, scanMaskAnyAVX2
+};
+#endif
+
+/* ---------------- DISPATCH ---------------- */
+static inline const ScanKernels *scanSelect(void) {
+    const char *force = getenv("LEX_SCAN");
+    if (force && strcmp(force, "scalar") == 0) return &scanScalar;
+#ifdef SCAN_X86
+    __builtin_cpu_init();
+    if (force && strcmp(force, "sse2") == 0) return &scanSSE2;
+    if (__builtin_cpu_supports("avx2")) return &scanAVX2;
+    if (__builtin_cpu_supports("sse2")) return &scanSSE2;
+#endif
+    return &scanScalar;
+}
+
+#endif
@@ -0,0 +1,120 @@
+#ifndef SQLSTMT_H
+#define SQLSTMT_H
+
+/* ================= SQL STATEMENTS =================
+ * Where each statement of an SQL input begins and ends, found from the
+ * tokens, so a ';' inside a string or a comment never splits one. A
+ * statement runs from its first token through its ';'; the last one, if
+ * it has no ';', runs to the end of the input. A ';' with nothing before
+ * it is not a statement.
+ *
+ * A StmtBuilder is fed the tokens of a pass that is lexing anyway (the
+ * sql lexer's -x index) and reports each statement as its ';' goes by:
+ *
+ *   StmtBuilder b;
+ *   stmtBegin(&b, data);
+ *   while (lexer_next(&lx, &t))
+ *       if (stmtToken(&b, &t, &s)) ...
+ *   if (stmtFinish(&b, len, &s)) ...
+ *
+ * A StmtCursor does the same lexing itself and hands out statements
+ * without keeping any token, for a loader that dispatches each one to a
+ * worker as soon as it is found:
+ *
+ *   StmtCursor c;
+ *   stmtOpen(&c, &lx);
+ *   while (stmtNext(&c, &s))
+ *       ...                     s.start, s.end: the statement's bytes
+ */
+#include "lexer.h"
+
+typedef struct sqlStatement {
+    size_t start, end;       // bytes [start, end) of the input
+    int row;                 // line of the first token
+    int keyword;             // id of its first keyword, -1 if it has none
+    uint64_t firstToken;     // index of its first token in the token stream
+    uint64_t tokens;         // number of tokens, the ';' included
+} SqlStatement;
+
+typedef struct stmtBuilder {
+    const char *base;        // start of the input; offsets are relative to it
+    uint64_t items;          // tokens seen so far
+    int open;                // cur has a token in it
+    SqlStatement cur;
+} StmtBuilder;
+
+static inline void stmtBegin(StmtBuilder *b, const char *base) {
+    memset(b, 0, sizeof(*b));
+    b->base = base;
+}
+
+/* Account for the next token; returns 1 when it ends a statement, which
+ * is then in *s. */
+static inline int stmtToken(StmtBuilder *b, const Token *t, SqlStatement *s) {
+    int semicolon = t->kind == TOK_DELIM && t->text.ptr[0] == ';';
+    if (!b->open) {
+        if (semicolon) { b->items++; return 0; }
+        b->cur.start = t->text.ptr - t->quotes - b->base;
+        b->cur.row = t->row;
+        b->cur.keyword = -1;
+        b->cur.firstToken = b->items;
+        b->open = 1;
+    }
+    b->items++;
+    if (b->cur.keyword < 0 && t->kind == TOK_KEYWORD) b->cur.keyword = t->keyword;
+    if (!semicolon) return 0;
+    b->cur.end = t->text.ptr + 1 - b->base;
+    b->cur.tokens = b->items - b->cur.firstToken;
+    b->open = 0;
+    *s = b->cur;
+    return 1;
+}
+
+/* Count an item that stands in for tokens, such as a VALUES row
+ * (sqlvalues.h), which can only come inside a statement. */
+static inline void stmtItem(StmtBuilder *b) {
+    b->items++;
+}
+
+/* At the end of an input of len bytes: returns 1 with the last statement
+ * in *s if it had no ';'. */
+static inline int stmtFinish(StmtBuilder *b, size_t len, SqlStatement *s) {
+    if (!b->open) return 0;
+    b->cur.end = len;
+    b->cur.tokens = b->items - b->cur.firstToken;
+    b->open = 0;
+    *s = b->cur;
+    return 1;
+}
+
+/* The statement's first keyword, e.g. "INSERT", as spelled in the
+ * language's keyword list; "-" if it has none. */
+static inline const char *stmtKeyword(const LanguageDef *def, const SqlStatement *s) {
+    return s->keyword < 0 ? "-" : def->keywords[s->keyword];
+}
+
+/* ---------------- CURSOR ---------------- */
+typedef struct stmtCursor {
+    Lexer *lx;
+    StmtBuilder b;
+    int done;
+} StmtCursor;
+
+/* Iterate the statements of lx's input from its cursor on. */
+static inline void stmtOpen(StmtCursor *c, Lexer *lx) {
+    c->lx = lx;
+    c->done = 0;
+    stmtBegin(&c->b, lx->src.data);
+}
+
+/* Fill s with the next statement; returns 1, or 0 after the last one. */
+static inline int stmtNext(StmtCursor *c, SqlStatement *s) {
+    Token t;
+    if (c->done) return 0;
+    while (lexer_next(c->lx, &t))
+        if (stmtToken(&c->b, &t, s)) return 1;
+    c->done = 1;
+    return stmtFinish(&c->b, c->lx->src.len, s);
+}
+
+#endif
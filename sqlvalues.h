@@ -0,0 +1,255 @@
+#ifndef SQLVALUES_H
+#define SQLVALUES_H
+
+/* ================= BULK INSERT FAST PATH =================
+ * SQL dumps are mostly long VALUES lists:
+ *
+ *   INSERT INTO t VALUES (1,'a',2.5),(2,'b',NULL),...;
+ *
+ * A ValuesLexer hands out the same tokens as lexer_next(), but after a
+ * VALUES keyword it takes a whole tuple at a time, with a loop that knows
+ * only what tuples hold: blanks, numbers, quoted strings, names, signs and
+ * commas. The tuple's tokens go into a batch, the ',' after it included,
+ * and come out of the batch one by one.
+ *
+ *   ValuesLexer vl;
+ *   valuesOpen(&vl, &lexer, 0);
+ *   while (valuesNext(&vl, &t, NULL))
+ *       ...
+ *   valuesClose(&vl);
+ *
+ * Opened with rowsOnly, a tuple makes no tokens at all: valuesNext()
+ * returns VALUES_ROW with its span, position and number of values instead.
+ * The tuple is then crossed with scan->maskAny(), 64 bytes at a time, and
+ * the names in it (NULL, TRUE) are not entered as symbols.
+ *
+ * Anything a tuple should not hold (a comment, a nested parenthesis, an
+ * unterminated string, an unknown byte) sends the lexer back to the '('
+ * and the rest of the statement through lexer_next(), so the output is
+ * the same either way. Symbols a failed tuple entered are entered again,
+ * in the same order, so the table is the same too.
+ *
+ * In rowsOnly mode only what moves a row's end or changes its number of
+ * values is checked: comments, parentheses, a ';' and unterminated
+ * strings fall back. The bytes between the quotes, commas and parentheses
+ * are not looked at, so an unknown byte there is passed over as part of
+ * the row rather than reported as an invalid token. Checking them would
+ * cost a pass over every byte of the row.
+ */
+#include "lexer.h"
+
+enum { VALUES_TOKEN = 1, VALUES_ROW = 2 };
+
+/* One tuple of a VALUES list, in rowsOnly mode. */
+typedef struct valuesRow {
+    Lexeme text;             // "(" to ")"
+    int row, col;            // of the "("
+    uint32_t columns;        // values in it; 0 for "()"
+} ValuesRow;
+
+typedef struct valuesLexer {
+    Lexer *lx;
+    int rowsOnly;
+    int valuesKeyword;       // keyword id of VALUES, -1 if the language has none
+    int inList;              // the cursor is where a tuple may start
+    Token *batch;            // tokens of the last tuple taken
+    size_t count, cap, next;
+    uint64_t rows;           // tuples taken by the fast path
+    uint64_t fallbacks;      // tuples left to lexer_next()
+} ValuesLexer;
+
+static inline void valuesOpen(ValuesLexer *vl, Lexer *lx, int rowsOnly) {
+    memset(vl, 0, sizeof(*vl));
+    vl->lx = lx;
+    vl->rowsOnly = rowsOnly;
+    vl->valuesKeyword = kwLookup(&lx->keywords, "VALUES", 6);
+}
+
+static inline void valuesClose(ValuesLexer *vl) {
+    free(vl->batch);
+    vl->batch = NULL;
+}
+
+/* ---------------- TUPLES ---------------- */
+
+/* Skip blanks and line breaks from p, as lexScan() would. */
+static inline const char *valuesSkip(Lexer *lx, const char *p, const char *end) {
+    const uint8_t *cls = lx->tables.charClass;
+    while (p < end) {
+        int kind = cls[(uint8_t)*p] & CC_KIND;
+        if (kind == CC_SPACE) {
+            if (++p < end && (cls[(uint8_t)*p] & CC_KIND) == CC_SPACE)
+                p = lx->scan->skipBlanks(p, end);
+        } else if (kind == CC_NEWLINE) {
+            lx->row++;
+            lx->lineStart = ++p - lx->src.data;
+            lx->midLine = 0;
+        } else {
+            break;
+        }
+    }
+    return p;
+}
+
+static inline Token *valuesSlot(ValuesLexer *vl) {
+    if (vl->count == vl->cap) {
+        size_t cap = vl->cap ? vl->cap * 2 : 64;
+        Token *bigger = realloc(vl->batch, cap * sizeof(Token));
+        if (!bigger) return NULL;
+        vl->batch = bigger;
+        vl->cap = cap;
+    }
+    return &vl->batch[vl->count++];
+}
+
+/* Lex the tuple at p into the batch. Returns the end of the tuple, or NULL
+ * for one to leave to lexer_next(). */
+static const char *valuesTokens(ValuesLexer *vl, const char *p, const char *end) {
+    Lexer *lx = vl->lx;
+    const uint8_t *cls = lx->tables.charClass;
+    const char *data = lx->src.data;
+    Token *t;
+    if (!(t = valuesSlot(vl))) return NULL;
+    lexEmit(lx, t, TOK_DELIM, p, 1, p + 1);
+    for (;;) {
+        p = valuesSkip(lx, data + lx->src.pos, end);
+        if (p == end || !(t = valuesSlot(vl))) return NULL;
+        const char *close;
+        switch (*p) {
+        case '\'':
+            if (!(close = memchr(p + 1, '\'', end - p - 1))) return NULL;
+            lexEmitQuoted(lx, t, TOK_STRING, p, 1, close, end);
+            lexLines(lx, p + 1, close);
+            continue;
+        case ',':
+            lexEmit(lx, t, TOK_DELIM, p, 1, p + 1);
+            continue;
+        case ')':
+            lexEmit(lx, t, TOK_DELIM, p, 1, p + 1);
+            return p + 1;
+        case '-':
+        case '+':
+            if (end - p > 1 && (p[1] == '-' || p[1] == '=')) return NULL;   // a comment, or "-="
+            lexEmit(lx, t, TOK_OP, p, 1, p + 1);
+            continue;
+        }
+        switch (cls[(uint8_t)*p] & CC_KIND) {
+        case CC_DIGIT:
+            lexNumber(lx, t, p);
+            break;
+        case CC_IDENT:
+            lexWord(lx, t, p);
+            break;
+        default:
+            return NULL;
+        }
+    }
+}
+
+/* Cross the tuple at p without making tokens, 64 bytes at a time: a mask
+ * of the bytes that matter in each block is walked bit by bit, and
+ * between quotes only quotes and line breaks count. Other bytes are never
+ * looked at. Returns the end of the tuple, or NULL for one to leave to
+ * lexer_next(). */
+static const char *valuesSpan(ValuesLexer *vl, const char *p, const char *end, ValuesRow *row) {
+    Lexer *lx = vl->lx;
+    row->row = lx->row;
+    row->col = (int)(p - lx->src.data - lx->lineStart) + 1;
+    row->text.ptr = p;
+    const char *q = valuesSkip(lx, p + 1, end);
+    row->columns = q < end && *q == ')' ? 0 : 1;
+    int quoted = 0;
+    for (const char *block = q; block < end; block += 64) {
+        uint64_t mask = lx->scan->maskAny(block, end, "'(),;\n-/");
+        for (; mask; mask &= mask - 1) {
+            const char *c = block + __builtin_ctzll(mask);
+            if (*c == '\n') {
+                lx->row++;
+                lx->lineStart = c + 1 - lx->src.data;
+            } else if (*c == '\'') {
+                quoted = !quoted;
+            } else if (quoted) {
+                continue;
+            } else if (*c == ',') {
+                row->columns++;
+            } else if (*c == ')') {
+                row->text.len = (int)(c + 1 - p);
+                lx->src.pos = c + 1 - lx->src.data;
+                lx->prevKeyword = -1;
+                lx->midLine = 1;
+                return c + 1;
+            } else if (*c == '-' || *c == '/') {
+                if (end - c > 1 && c[1] == (*c == '-' ? '-' : '*')) return NULL;   // a comment
+            } else {
+                return NULL;    // '(' or ';'
+            }
+        }
+    }
+    return NULL;
+}
+
+/* Take the tuple at the cursor, and the ',' after it. Returns 1, or 0 with
+ * the lexer where it was. */
+static int valuesTuple(ValuesLexer *vl, ValuesRow *row) {
+    Lexer *lx = vl->lx;
+    LexState before = lexer_state(lx);
+    const char *data = lx->src.data, *end = data + lx->src.len;
+    const char *p = valuesSkip(lx, data + lx->src.pos, end);
+    vl->count = vl->next = 0;
+    if (p >= data + lx->limit || *p != '(' ||
+        !(p = vl->rowsOnly ? valuesSpan(vl, p, end, row) : valuesTokens(vl, p, end))) {
+        lexer_seek(lx, before);
+        vl->count = 0;
+        vl->fallbacks++;
+        return 0;
+    }
+    vl->rows++;
+    p = valuesSkip(lx, p, end);
+    lx->src.pos = p - data;
+    vl->inList = p < end && *p == ',';
+    if (vl->inList) {
+        Token comma, *t = vl->rowsOnly ? &comma : valuesSlot(vl);
+        if (t) lexEmit(lx, t, TOK_DELIM, p, 1, p + 1);
+        else vl->inList = 0;    // out of memory: lexer_next() makes the ','
+    }
+    return 1;
+}
+
+/* ---------------- API ---------------- */
+
+/* Fill t with the next token, or in rowsOnly mode row with the next tuple.
+ * Returns VALUES_TOKEN, VALUES_ROW, or 0 at the end of the input. */
+static inline int valuesNext(ValuesLexer *vl, Token *t, ValuesRow *row) {
+    Lexer *lx = vl->lx;
+    if (vl->next < vl->count) {
+        *t = vl->batch[vl->next++];
+        return VALUES_TOKEN;
+    }
+    if (vl->inList) {
+#ifdef LEX_STATS
+        LexStats *s = &lx->stats;
+        uint64_t entered = statTick();
+        if (s->leftTick) s->ticks[ST_OUTPUT] += entered - s->leftTick;
+        int taken = valuesTuple(vl, row);
+        s->leftTick = statTick();
+        s->ticks[ST_SCAN] += s->leftTick - entered;
+        for (size_t i = 0; i < vl->count; i++) {
+            s->tokens[vl->batch[i].kind]++;
+            s->tokenBytes[vl->batch[i].kind] += vl->batch[i].text.len;
+        }
+#else
+        int taken = valuesTuple(vl, row);
+#endif
+        if (taken && vl->rowsOnly) return VALUES_ROW;
+        if (taken) {
+            *t = vl->batch[vl->next++];
+            return VALUES_TOKEN;
+        }
+        vl->inList = 0;
+    }
+    if (!lexer_next(lx, t)) return 0;
+    vl->inList = t->kind == TOK_KEYWORD && t->keyword == vl->valuesKeyword;
+    return VALUES_TOKEN;
+}
+
+#endif
@@ -1,307 +1,212 @@
-#include <stdio.h>
-#include <ctype.h>
-#include <string.h>
-#include <stdlib.h>
-
-
-
-const char *keywords[] = {
-    "int","float","char","double","if","else",
-    "while","for","return","void","break","continue"
-};
-
-
-
-#define TABLE_SIZE 50
-
-#include <stdlib.h>
-
-#define TABLE_SIZE 50
-
-typedef struct node {
-    char name[50];
-    char type[20];
-    char argument[100];
-    struct node *next;
-} Node;
-
-Node *symbolTable[TABLE_SIZE] = {NULL};
-
-int hashFunction(char *str) {
-    int sum = 0;
-    for (int i = 0; str[i] != '\0'; i++)
-        sum += str[i];
-    return sum % TABLE_SIZE;
-}
-
-void insertSymbol(char *name, char *type, char *arg) {
-    int index = hashFunction(name);
-
-    Node *temp = symbolTable[index];
-    while (temp) {
-        if (strcmp(temp->name, name) == 0)
-            return;
-        temp = temp->next;
-    }
-
-    Node *newNode = (Node *)malloc(sizeof(Node));
-    strcpy(newNode->name, name);
-    strcpy(newNode->type, type);
-
-    if (arg)
-        strcpy(newNode->argument, arg);
-    else
-        strcpy(newNode->argument, "-");
-
-    newNode->next = symbolTable[index];
-    symbolTable[index] = newNode;
-}
-
-void printSymbolTable() {
-    printf("\nTOKEN TABLE\n");
-    printf("TokenName\tTokenType\tArgument\n");
-
-    for (int i = 0; i < TABLE_SIZE; i++) {
-        Node *temp = symbolTable[i];
-        while (temp) {
-            printf("%s\t\t%s\t\t%s\n",
-                   temp->name,
-                   temp->type,
-                   temp->argument);
-            temp = temp->next;
-        }
-    }
-}
-
-
-
-int isKeyword(char *str) {
-    int total = sizeof(keywords)/sizeof(keywords[0]);
-    for (int i = 0; i < total; i++)
-        if (strcmp(str, keywords[i]) == 0)
-            return 1;
-    return 0;
-}
-
-int isOperator(char c) {
-    return (c=='+'||c=='-'||c=='*'||c=='/'||
-            c=='='||c=='<'||c=='>'||c=='!'||
-            c=='&'||c=='|'||c=='%');
-}
-
-int isDelimiter(char c) {
-    return (c=='('||c==')'||c=='{'||c=='}'||
-            c=='['||c==']'||c==';'||c==','||c=='.');
-}
-
-/* ---------- PREPROCESSOR ---------- */
-
-void hash(FILE *fp) {
-    int ch;
-    while ((ch = getc(fp)) != '\n' && ch != EOF);
-    if (ch == '\n') ungetc(ch, fp);
-}
-
-/* ---------- COMMENTS ---------- */
-
-void bar(FILE *fp, int *row, int *col) {
-    int ch = getc(fp);
-
-    if (ch == '/') {
-        while ((ch = getc(fp)) != '\n' && ch != EOF);
-        if (ch == '\n') ungetc(ch, fp);
-    }
-    else if (ch == '*') {
-        int prev = 0;
-        while ((ch = getc(fp)) != EOF) {
-            if (ch == '\n') {
-                (*row)++;
-                *col = 1;
-            } else (*col)++;
-
-            if (prev == '*' && ch == '/') break;
-            prev = ch;
-        }
-    }
-    else {
-        printf("<OP, /, %d, %d>\n", *row, *col);
-        if (ch != EOF) ungetc(ch, fp);
-        (*col)++;
-    }
-}
-
-/* ---------- IDENTIFIER / KEYWORD ---------- */
-
-void letter(FILE *fp, int first, int *col, int row) {
-    char buffer[100];
-    int i = 0, ch;
-    buffer[i++] = first;
-
-    while ((ch = getc(fp)) != EOF && (isalnum(ch) || ch == '_'))
-        buffer[i++] = ch;
-
-    buffer[i] = '\0';
-
-    if (ch != EOF) ungetc(ch, fp);
-
-    if (isKeyword(buffer)) {
-        printf("<KEYWORD, %s, %d, %d>\n", buffer, row, *col);
-    }
-    else {
-        int next = getc(fp);
-
-        if (next == '(') {
-            printf("<FUNC, %s, %d, %d>\n", buffer, row, *col);
-            insertSymbol(buffer, "FUNC", "-");
-            ungetc(next, fp);
-        }
-        else {
-            printf("<IDENTIFIER, %s, %d, %d>\n", buffer, row, *col);
-            insertSymbol(buffer, "Identifier", "-");
-            if (next != EOF) ungetc(next, fp);
-        }
-    }
-
-    *col += strlen(buffer);
-}
-
-
-/* ---------- NUMBER ---------- */
-
-void number(FILE *fp, int first, int *col, int row) {
-    char buffer[100];
-    int i = 0, ch;
-    buffer[i++] = first;
-
-    while ((ch = getc(fp)) != EOF && isdigit(ch))
-        buffer[i++] = ch;
-
-    buffer[i] = '\0';
-    if (ch != EOF) ungetc(ch, fp);
-
-    printf("<NUMBER, %s, %d, %d>\n", buffer, row, *col);
-    *col += strlen(buffer);
-}
-
-/* ---------- STRING ---------- */
-
-void stringLiteral(FILE *fp, int row, int *col) {
-    int ch;
-    int startCol = *col;
-    printf("<STRING, \"");
-    (*col)++;
-
-    while ((ch = getc(fp)) != EOF && ch != '"') {
-        putchar(ch);
-        (*col)++;
-    }
-
-    printf("\", %d, %d>\n", row, startCol);
-    (*col)++;
-}
-
-/* ---------- CHAR ---------- */
-
-void charLiteral(FILE *fp, int row, int *col) {
-    int ch;
-    int startCol = *col;
-    printf("<CHAR, '");
-    (*col)++;
-
-    while ((ch = getc(fp)) != EOF && ch != '\'') {
-        putchar(ch);
-        (*col)++;
-    }
-
-    printf("', %d, %d>\n", row, startCol);
-    (*col)++;
-}
-
-/* ---------- OPERATOR ---------- */
-
-void OperatorHandler(FILE *fp, char ch, int row, int *col) {
-    int next = getc(fp);
-
-    if (next == '=' ||
-        (ch == '+' && next == '+') ||
-        (ch == '-' && next == '-') ||
-        (ch == '&' && next == '&') ||
-        (ch == '|' && next == '|')) {
-
-        printf("<OP, %c%c, %d, %d>\n", ch, next, row, *col);
-        (*col) += 2;
-    }
-    else {
-        if (next != EOF) ungetc(next, fp);
-        printf("<OP, %c, %d, %d>\n", ch, row, *col);
-        (*col) += 1;
-    }
-}
-
-/* ---------- DELIMITER ---------- */
-
-void delimiter(char c, int row, int *col) {
-    printf("<DELIM, %c, %d, %d>\n", c, row, *col);
-    (*col)++;
-}
-
-/* ---------- MAIN ---------- */
-
-int main() {
-    FILE *fp;
-    int c;
-    int row = 1, col = 1;
-
-    fp = fopen("input.c", "r");
-
-    if (!fp) {
-        printf("File not found\n");
-        return 1;
-    }
-
-    while ((c = getc(fp)) != EOF) {
-        if (c == '\n') {
-            row++;
-            col = 1;
-        }
-        else if (isspace(c)) {
-            col++;
-        }
-        else if (c == '#') {
-            printf("<PREPROC, #, %d, %d>\n", row, col);
-            hash(fp);
-            col = 1;
-        }
-        else if (c == '/') {
-            bar(fp, &row, &col);
-        }
-        else if (isalpha(c) || c == '_') {
-            letter(fp, c, &col, row);
-        }
-        else if (isdigit(c)) {
-            number(fp, c, &col, row);
-        }
-        else if (c == '"') {
-            stringLiteral(fp, row, &col);
-        }
-        else if (c == '\'') {
-            charLiteral(fp, row, &col);
-        }
-        else if (isOperator(c)) {
-            OperatorHandler(fp, c, row, &col);
-        }
-        else if (isDelimiter(c)) {
-            delimiter(c, row, &col);
-        }
-        else {
-            printf("Invalid token at %d %d\n", row, col);
-            col++;
-        }
-    }
-
-    fclose(fp);
-
-    printSymbolTable();   // print symbol table
-
-    return 0;
-}
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "lexer.h"
+#include "parlex.h"
+#include "tokstore.h"
+#include "outbuf.h"
+#include "symsnap.h"
+#include "lexstream.h"
+
+
+
+/* ---------- OUTPUT ---------- */
+
+const char *kindNames[TOK_KIND_COUNT] = {
+    [TOK_KEYWORD] = "KEYWORD", [TOK_IDENTIFIER] = "IDENTIFIER", [TOK_FUNC] = "FUNC",
+    [TOK_NUMBER] = "NUMBER", [TOK_OP] = "OP", [TOK_DELIM] = "DELIM", [TOK_PREPROC] = "PREPROC"
+};
+
+int binaryOutput = 0;       // -b: tokens go to tokenFile instead of stdout
+TokenWriter tokenFile;
+OutBuf out;                 // stdout
+SymbolSpill spill;          // -S: symbols spilled while streaming
+
+void emit(const Token *t) {
+    Lexeme lx = t->text;
+
+    if (binaryOutput) {
+        twAppend(&tokenFile, t->kind, lx, t->row, t->col);
+        return;
+    }
+
+    switch (t->kind) {
+    case TOK_STRING:
+        outStr(&out, "<STRING, \"");
+        outSpan(&out, lx.ptr, lx.len);
+        outStr(&out, "\", ");
+        break;
+    case TOK_CHAR:
+        outStr(&out, "<CHAR, '");
+        outSpan(&out, lx.ptr, lx.len);
+        outStr(&out, "', ");
+        break;
+    case TOK_INVALID:
+        outStr(&out, "Invalid token at ");
+        outInt(&out, t->row);
+        outChar(&out, ' ');
+        outInt(&out, t->col);
+        outChar(&out, '\n');
+        return;
+    default:
+        outChar(&out, '<');
+        outStr(&out, kindNames[t->kind]);
+        outStr(&out, ", ");
+        outSpan(&out, lx.ptr, lx.len);
+        outStr(&out, ", ");
+    }
+    outInt(&out, t->row);
+    outStr(&out, ", ");
+    outInt(&out, t->col);
+    outStr(&out, ">\n");
+}
+
+/* ---------- SYMBOL TABLE ---------- */
+
+const char *symbolTypeNames[] = { "Identifier", "FUNC" };
+
+void printSymbols(OutBuf *o, const Lexer *lexer) {
+    for (uint32_t i = 0; i < lexer->symbolCount; i++) {
+        const Symbol *temp = &lexer->symbols[i];
+        outStr(o, poolString(&lexer->names, temp->name));
+        outStr(o, "\t\t");
+        outStr(o, symbolTypeNames[temp->type]);
+        outStr(o, "\t\t-\n");
+    }
+}
+
+void printSymbolTable(const Lexer *lexer) {
+    outStr(&out, "\nTOKEN TABLE\n");
+    outStr(&out, "TokenName\tTokenType\tArgument\n");
+
+    if (spill.fp)
+        spillReplay(&spill, &out);
+    printSymbols(&out, lexer);
+}
+
+/* ---------- MAIN ---------- */
+
+int main(int argc, char **argv) {
+    const char *binPath = NULL, *snapPath = NULL;
+    int threads = 1;
+    int stats = 0;        // 1 = --stats, 2 = --stats=json
+    int streaming = 0;    // -: lex stdin as a stream
+    int symbolLimit = 0;  // -S: symbols kept before spilling
+
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "-b") == 0 && i + 1 < argc)
+            binPath = argv[++i];
+        else if (strcmp(argv[i], "-s") == 0 && i + 1 < argc)
+            snapPath = argv[++i];
+        else if (strcmp(argv[i], "-j") == 0 && i + 1 < argc)
+            threads = atoi(argv[++i]);
+        else if (strcmp(argv[i], "-") == 0)
+            streaming = 1;
+        else if (strcmp(argv[i], "-S") == 0 && i + 1 < argc)
+            symbolLimit = atoi(argv[++i]);
+        else if (strcmp(argv[i], "--stats") == 0)
+            stats = 1;
+        else if (strcmp(argv[i], "--stats=json") == 0)
+            stats = 2;
+        else {
+            printf("usage: %s [-b tokens.bin] [-s symbols.snap] [-j threads] [--stats[=json]] [- [-S symbols]]\n", argv[0]);
+            return 1;
+        }
+    }
+    if (streaming ? binPath || threads > 1 : symbolLimit > 0) {
+        printf("-S needs -, which cannot be combined with -b or -j\n");
+        return 1;
+    }
+    if (symbolLimit > 0 && snapPath) {
+        printf("-S cannot be combined with -s\n");
+        return 1;
+    }
+
+    Source src = { 0 };
+    Lexer lexer;
+    Token t;
+
+    uint64_t started = statTick();
+    if (!streaming && srcOpen(&src, "input.c") != 0) {
+        printf("File not found\n");
+        return 1;
+    }
+
+    if (lexer_open(&lexer, src.data, src.len, LANG_C) != 0) {
+        printf("Cannot build keyword table\n");
+        return 1;
+    }
+    lexer_stats_input(&lexer, started);
+
+    outOpen(&out, STDOUT_FILENO);
+    if (binPath) {
+        if (twOpen(&tokenFile, binPath, src.data) != 0) {
+            printf("Cannot open %s\n", binPath);
+            return 1;
+        }
+        binaryOutput = 1;
+    }
+
+    if (streaming) {
+        LexStream ls;
+        if (streamOpen(&ls, &lexer, STDIN_FILENO, STREAM_WINDOW) != 0) {
+            printf("Out of memory\n");
+            return 1;
+        }
+        if (symbolLimit > 0) {
+            if (spillOpen(&spill, printSymbols) != 0) {
+                printf("Cannot create a spill file\n");
+                return 1;
+            }
+            streamSpillAt(&ls, symbolLimit, spillSymbols, &spill);
+        }
+        while (streamNext(&ls, &t))
+            emit(&t);
+        int error = ls.error;
+        streamClose(&ls);
+        if (error) {
+            outFlush(&out);
+            printf("Cannot read input: %s\n", strerror(error));
+            return 1;
+        }
+    } else if (threads > 1) {
+        WorkPool wp;
+        ParLexer pl;
+        if (wpStart(&wp, threads) != 0) {
+            printf("Cannot start worker threads\n");
+            return 1;
+        }
+        parOpen(&pl, &lexer, &wp, PAR_CHUNK);
+        while (parNext(&pl, &t))
+            emit(&t);
+        parClose(&pl);
+        wpStop(&wp);
+    } else {
+        while (lexer_next(&lexer, &t))
+            emit(&t);
+    }
+
+    if (binaryOutput && twClose(&tokenFile) != 0) {
+        printf("Cannot write %s\n", binPath);
+        return 1;
+    }
+
+    if (snapPath && snapSave(&lexer, snapPath) != 0) {
+        printf("Cannot write %s\n", snapPath);
+        return 1;
+    }
+
+    uint64_t printed = statTick();
+    printSymbolTable(&lexer);   // print symbol table
+    if (outFlush(&out) != 0)
+        return 1;
+    lexer_stats_charge(&lexer, ST_OUTPUT, printed);
+    if (stats)
+        lexer_stats_report(&lexer, stderr, stats == 2);
+
+    lexer_close(&lexer);
+    spillClose(&spill);
+    srcClose(&src);
+
+    return 0;
+}
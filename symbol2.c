@@ -1,190 +1,157 @@
-#include <stdio.h>
-#include <stdlib.h>
-#include <ctype.h>
-#include <string.h>
-
-#define TABLE_SIZE 101
-
-/* ================= SYMBOL TABLE ================= */
-typedef struct entry {
-    char name[50];       // variable or function name
-    char type[20];       // int, float, string, etc.
-    char scope[50];      // Global / Local (function name)
-    char category[20];   // FUNCTION / VARIABLE / CONSTANT / IDENTIFIER
-    char info[100];      // additional info: return type, stack allocated, etc.
-    struct entry *next;
-} Entry;
-
-Entry *symbolTable[TABLE_SIZE] = {NULL};
-
-int hash(char *str) {
-    unsigned long h = 5381;
-    int c;
-    while ((c = *str++))
-        h = ((h << 5) + h) + c;
-    return h % TABLE_SIZE;
-}
-
-void insertSymbol(char *name, char *type, char *scope, char *category, char *info) {
-    int idx = hash(name);
-    Entry *temp = symbolTable[idx];
-    while (temp) {
-        if (strcmp(temp->name, name) == 0 && strcmp(temp->scope, scope) == 0)
-            return;
-        temp = temp->next;
-    }
-    Entry *newNode = malloc(sizeof(Entry));
-    strcpy(newNode->name, name);
-    strcpy(newNode->type, type);
-    strcpy(newNode->scope, scope);
-    strcpy(newNode->category, category);
-    strcpy(newNode->info, info);
-    newNode->next = symbolTable[idx];
-    symbolTable[idx] = newNode;
-}
-
-void printSymbolTable() {
-    printf("\n%-15s %-10s %-15s %-12s %-20s\n",
-           "Name", "Type", "Scope", "Category", "Additional Info");
-    printf("-------------------------------------------------------------------------------\n");
-    for (int i = 0; i < TABLE_SIZE; i++) {
-        Entry *t = symbolTable[i];
-        while (t) {
-            printf("%-15s %-10s %-15s %-12s %-20s\n",
-                   t->name, t->type, t->scope, t->category, t->info);
-            t = t->next;
-        }
-    }
-}
-
-/* ================= LANGUAGE SIGNATURE ================= */
-const char *keywords[] = {
-    "int","float","char","double","void","if","else","while","for","return","const"
-};
-int isKeyword(char *str) {
-    int n = sizeof(keywords)/sizeof(keywords[0]);
-    for (int i = 0; i < n; i++)
-        if (strcmp(str, keywords[i]) == 0)
-            return 1;
-    return 0;
-}
-
-const char *multi_ops[] = {
-    "==","!=","<=",">=","&&","||","++","--"
-};
-
-char single_ops[] = "+-*/%=!<>|&";
-char delimiters[] = "(){}[];,";
-
-/* ================= HELPERS ================= */
-int isMultiOperator(char *str) {
-    int n = sizeof(multi_ops)/sizeof(multi_ops[0]);
-    for (int i = 0; i < n; i++)
-        if (strcmp(str, multi_ops[i]) == 0)
-            return 1;
-    return 0;
-}
-
-/* ================= PREPROCESSOR / COMMENTS ================= */
-void skipComments(FILE *fp, int *row, int *col) {
-    int ch = fgetc(fp);
-    if (ch == '/') { // single line
-        while ((ch = fgetc(fp)) != '\n' && ch != EOF);
-        (*row)++; *col = 1;
-    } else if (ch == '*') { // multi line
-        int prev = 0;
-        while ((ch = fgetc(fp)) != EOF) {
-            if (ch == '\n') { (*row)++; *col = 1; }
-            if (prev == '*' && ch == '/') break;
-            prev = ch;
-        }
-    } else {
-        ungetc(ch, fp);
-        printf("<OP,/,%d,%d>\n", *row, *col);
-        (*col)++;
-    }
-}
-
-/* ================= TOKEN HANDLERS ================= */
-void handleIdentifier(FILE *fp, char first, int row, int *col, char *currentScope) {
-    char buffer[100]; int i = 0, ch;
-    buffer[i++] = first;
-    while ((ch = fgetc(fp)) != EOF && (isalnum(ch) || ch == '_'))
-        buffer[i++] = ch;
-    buffer[i] = '\0';
-    if (ch != EOF) ungetc(ch, fp);
-
-    if (isKeyword(buffer)) {
-        printf("<KEYWORD,%s,%d,%d>\n", buffer, row, *col);
-    } else {
-        int next = fgetc(fp);
-        if (next == '(') { // function
-            printf("<FUNC,%s,%d,%d>\n", buffer, row, *col);
-            insertSymbol(buffer, "Unknown", "Global", "FUNCTION", "Returns Unknown");
-            ungetc(next, fp);
-            strcpy(currentScope, buffer); // set scope for local vars
-        } else { // variable
-            printf("<ID,%s,%d,%d>\n", buffer, row, *col);
-            insertSymbol(buffer, "Unknown", currentScope, "VARIABLE", "Stack allocated");
-            if (next != EOF) ungetc(next, fp);
-        }
-    }
-    *col += strlen(buffer);
-}
-
-void handleNumber(FILE *fp, char first, int row, int *col) {
-    char buffer[100]; int i = 0, ch;
-    buffer[i++] = first;
-    while ((ch = fgetc(fp)) != EOF && isdigit(ch))
-        buffer[i++] = ch;
-    buffer[i] = '\0';
-    if (ch != EOF) ungetc(ch, fp);
-    printf("<NUM,%s,%d,%d>\n", buffer, row, *col);
-    *col += strlen(buffer);
-}
-
-void handleOperator(FILE *fp, char ch, int row, int *col) {
-    char next = fgetc(fp);
-    char buf[3] = {ch, next, '\0'};
-    if (isMultiOperator(buf)) {
-        printf("<OP,%s,%d,%d>\n", buf, row, *col);
-        *col += 2;
-    } else {
-        if (next != EOF) ungetc(next, fp);
-        printf("<OP,%c,%d,%d>\n", ch, row, *col);
-        (*col)++;
-    }
-}
-
-void handleString(FILE *fp, int row, int *col) {
-    int ch; int start = *col;
-    printf("<STRING,\"");
-    while ((ch = fgetc(fp)) != EOF && ch != '"') {
-        putchar(ch); (*col)++;
-    }
-    printf("\",%d,%d>\n", row, start); (*col)++;
-}
-
-/* ================= MAIN LEXER ================= */
-int main() {
-    FILE *fp = fopen("input.c", "r");
-    if (!fp) { printf("Cannot open input.c\n"); return 1; }
-
-    int c, row = 1, col = 1;
-    char currentScope[50] = "Global";
-
-    while ((c = fgetc(fp)) != EOF) {
-        if (c == '\n') { row++; col = 1; }
-        else if (isspace(c)) col++;
-        else if (c == '/') skipComments(fp, &row, &col);
-        else if (isalpha(c) || c == '_') handleIdentifier(fp, c, row, &col, currentScope);
-        else if (isdigit(c)) handleNumber(fp, c, row, &col);
-        else if (c == '"') handleString(fp, row, &col);
-        else if (strchr(single_ops, c)) handleOperator(fp, c, row, &col);
-        else if (strchr(delimiters, c)) { printf("<SYM,%c,%d,%d>\n", c, row, col); col++; }
-    }
-
-    fclose(fp);
-    printSymbolTable();
-    return 0;
-}
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "lexer.h"
+#include "parlex.h"
+#include "tokstore.h"
+#include "outbuf.h"
+#include "symsnap.h"
+#include "lexstream.h"
+
+
+/* ================= OUTPUT ================= */
+const char *kindNames[TOK_KIND_COUNT] = {
+    [TOK_KEYWORD] = "KEYWORD", [TOK_IDENTIFIER] = "ID", [TOK_FUNC] = "FUNC",
+    [TOK_NUMBER] = "NUM", [TOK_OP] = "OP", [TOK_DELIM] = "SYM"
+};
+
+int binaryOutput = 0;       // -b: tokens go to tokenFile instead of stdout
+TokenWriter tokenFile;
+OutBuf out;                 // stdout
+SymbolSpill spill;          // -S: symbols spilled while streaming
+
+void emit(const Token *t) {
+    Lexeme lx = t->text;
+    if (binaryOutput) { twAppend(&tokenFile, t->kind, lx, t->row, t->col); return; }
+    if (t->kind == TOK_STRING) {
+        outStr(&out, "<STRING,\"");
+        outSpan(&out, lx.ptr, lx.len);
+        outStr(&out, "\",");
+    } else {
+        outChar(&out, '<');
+        outStr(&out, kindNames[t->kind]);
+        outChar(&out, ',');
+        outSpan(&out, lx.ptr, lx.len);
+        outChar(&out, ',');
+    }
+    outInt(&out, t->row);
+    outChar(&out, ',');
+    outInt(&out, t->col);
+    outStr(&out, ">\n");
+}
+
+/* ================= SYMBOL TABLE =================
+ * Functions are recorded in the Global scope, and identifiers in the
+ * innermost scope open where they are first seen: a function's parameters
+ * and body in that function's, a nested block in one named after the
+ * scope around it. Types are not inferred yet.
+ */
+const char *categoryNames[] = { [SYM_IDENTIFIER] = "VARIABLE", [SYM_FUNC] = "FUNCTION" };
+const char *infoNames[] = { [SYM_IDENTIFIER] = "Stack allocated", [SYM_FUNC] = "Returns Unknown" };
+
+void printRow(OutBuf *o, const char *name, const char *type, const char *scope,
+              const char *category, const char *info) {
+    outPad(o, name, 15);
+    outChar(o, ' ');
+    outPad(o, type, 10);
+    outChar(o, ' ');
+    outPad(o, scope, 15);
+    outChar(o, ' ');
+    outPad(o, category, 12);
+    outChar(o, ' ');
+    outPad(o, info, 20);
+    outChar(o, '\n');
+}
+
+void printSymbols(OutBuf *o, const Lexer *lexer) {
+    for (uint32_t i = 0; i < lexer->symbolCount; i++) {
+        const Symbol *t = &lexer->symbols[i];
+        printRow(o, poolString(&lexer->names, t->name), "Unknown", lexScopeName(lexer, t->scope),
+                 categoryNames[t->type], infoNames[t->type]);
+    }
+}
+
+void printSymbolTable(const Lexer *lexer) {
+    outChar(&out, '\n');
+    printRow(&out, "Name", "Type", "Scope", "Category", "Additional Info");
+    outStr(&out, "-------------------------------------------------------------------------------\n");
+    if (spill.fp) spillReplay(&spill, &out);
+    printSymbols(&out, lexer);
+}
+
+/* ================= MAIN LEXER ================= */
+int main(int argc, char **argv) {
+    const char *binPath = NULL, *snapPath = NULL;
+    int threads = 1, stats = 0;    // stats: 1 = --stats, 2 = --stats=json
+    int streaming = 0, symbolLimit = 0;
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "-b") == 0 && i + 1 < argc) binPath = argv[++i];
+        else if (strcmp(argv[i], "-s") == 0 && i + 1 < argc) snapPath = argv[++i];
+        else if (strcmp(argv[i], "-j") == 0 && i + 1 < argc) threads = atoi(argv[++i]);
+        else if (strcmp(argv[i], "-") == 0) streaming = 1;
+        else if (strcmp(argv[i], "-S") == 0 && i + 1 < argc) symbolLimit = atoi(argv[++i]);
+        else if (strcmp(argv[i], "--stats") == 0) stats = 1;
+        else if (strcmp(argv[i], "--stats=json") == 0) stats = 2;
+        else { printf("usage: %s [-b tokens.bin] [-s symbols.snap] [-j threads] [--stats[=json]] [- [-S symbols]]\n", argv[0]); return 1; }
+    }
+    if (streaming ? binPath || threads > 1 : symbolLimit > 0) {
+        printf("-S needs -, which cannot be combined with -b or -j\n");
+        return 1;
+    }
+    if (symbolLimit > 0 && snapPath) {
+        printf("-S cannot be combined with -s\n");
+        return 1;
+    }
+    Source src = { 0 };
+    uint64_t started = statTick();
+    if (!streaming && srcOpen(&src, "input.c") != 0) { printf("Cannot open input.c\n"); return 1; }
+    Lexer lexer;
+    if (lexer_open(&lexer, src.data, src.len, LANG_C_SCOPED) != 0) {
+        printf("Cannot build keyword table\n"); return 1;
+    }
+    lexer_stats_input(&lexer, started);
+    outOpen(&out, STDOUT_FILENO);
+    if (binPath) {
+        if (twOpen(&tokenFile, binPath, src.data) != 0) { printf("Cannot open %s\n", binPath); return 1; }
+        binaryOutput = 1;
+    }
+
+    Token t;
+    if (streaming) {
+        LexStream ls;
+        if (streamOpen(&ls, &lexer, STDIN_FILENO, STREAM_WINDOW) != 0) { printf("Out of memory\n"); return 1; }
+        if (symbolLimit > 0) {
+            if (spillOpen(&spill, printSymbols) != 0) { printf("Cannot create a spill file\n"); return 1; }
+            streamSpillAt(&ls, symbolLimit, spillSymbols, &spill);
+        }
+        while (streamNext(&ls, &t))
+            emit(&t);
+        int error = ls.error;
+        streamClose(&ls);
+        if (error) { outFlush(&out); printf("Cannot read input: %s\n", strerror(error)); return 1; }
+    } else if (threads > 1) {
+        WorkPool wp;
+        ParLexer pl;
+        if (wpStart(&wp, threads) != 0) { printf("Cannot start worker threads\n"); return 1; }
+        parOpen(&pl, &lexer, &wp, PAR_CHUNK);
+        while (parNext(&pl, &t))
+            emit(&t);
+        parClose(&pl);
+        wpStop(&wp);
+    } else {
+        while (lexer_next(&lexer, &t))
+            emit(&t);
+    }
+
+    if (binaryOutput && twClose(&tokenFile) != 0) { printf("Cannot write %s\n", binPath); return 1; }
+    if (snapPath && snapSave(&lexer, snapPath) != 0) { printf("Cannot write %s\n", snapPath); return 1; }
+    uint64_t printed = statTick();
+    printSymbolTable(&lexer);
+    if (outFlush(&out) != 0) return 1;
+    lexer_stats_charge(&lexer, ST_OUTPUT, printed);
+    if (stats) lexer_stats_report(&lexer, stderr, stats == 2);
+    lexer_close(&lexer);
+    spillClose(&spill);
+    srcClose(&src);
+    return 0;
+}
@@ -0,0 +1,68 @@
+#include <stdio.h>
+#include <string.h>
+#include "symsnap.h"
+#include "outbuf.h"
+
+/* Look names up in a symbol table snapshot written by a lexer's -s option,
+ * straight from the mapped file: nothing is lexed or loaded. Each name
+ * resolves from the Global scope or, with -f, from inside that function,
+ * innermost scope first. Without names the whole table is listed.
+ *
+ *   ./symbol2 -s table.snap && ./symquery -f main table.snap x y
+ *
+ * Prints name, type and scope for each; exits 1 if any name is missing.
+ */
+static const char *typeNames[] = { [SYM_IDENTIFIER] = "IDENTIFIER", [SYM_FUNC] = "FUNC" };
+
+static void printSymbol(OutBuf *out, const SymSnapshot *s, const Symbol *sym) {
+    outStr(out, snapName(s, sym->name));
+    outChar(out, '\t');
+    outStr(out, typeNames[sym->type]);
+    outChar(out, '\t');
+    outStr(out, snapName(s, s->scopes[sym->scope].name));
+    outChar(out, '\n');
+}
+
+int main(int argc, char **argv) {
+    const char *function = NULL;
+    int first = 1;
+    if (argc > 3 && strcmp(argv[1], "-f") == 0) {
+        function = argv[2];
+        first = 3;
+    }
+    if (first >= argc) {
+        printf("usage: %s [-f function] symbols.snap [name...]\n", argv[0]);
+        return 1;
+    }
+
+    SymSnapshot s;
+    int rc = snapOpen(&s, argv[first]);
+    if (rc == -1) { printf("Cannot open %s\n", argv[first]); return 1; }
+    if (rc == -2) { printf("%s is not a symbol snapshot\n", argv[first]); return 1; }
+
+    int scope = 0;
+    if (function && (scope = snapScope(&s, 0, function, strlen(function))) < 0) {
+        printf("No function %s in %s\n", function, argv[first]);
+        return 1;
+    }
+
+    static OutBuf out;
+    int missing = 0;
+    outOpen(&out, STDOUT_FILENO);
+    if (first + 1 == argc)
+        for (uint32_t i = 0; i < s.symbolCount; i++)
+            printSymbol(&out, &s, &s.symbols[i]);
+    for (int i = first + 1; i < argc; i++) {
+        int entry = snapResolve(&s, argv[i], strlen(argv[i]), scope);
+        if (entry >= 0) {
+            printSymbol(&out, &s, &s.symbols[entry]);
+        } else {
+            outStr(&out, argv[i]);
+            outStr(&out, "\tnot found\n");
+            missing = 1;
+        }
+    }
+    outFlush(&out);
+    snapClose(&s);
+    return missing;
+}
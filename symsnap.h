@@ -0,0 +1,338 @@
+#ifndef SYMSNAP_H
+#define SYMSNAP_H
+
+/* ================= SYMBOL TABLE SNAPSHOTS =================
+ * A lexer's symbol table saved in the form it has in memory, so that it
+ * can be mapped and searched where it lies instead of rebuilt by lexing
+ * again. Every reference inside is an id or a file offset, never a
+ * pointer, and each section is an array the lexer itself keeps: even the
+ * hash indexes' slots are stored as they are, so a lookup probes the
+ * mapped pages directly and opening a snapshot costs a page fault, not a
+ * pass over it.
+ *
+ * File layout (host byte order, checked on open; sections 8-byte aligned):
+ *
+ *   "SYMS"  u32 version  u32 byte order mark  u32 language
+ *   u32 symbols  u32 scopes  u32 names  u32 name bytes
+ *   u32 slots in the symbol, scope and name indexes  u32 zero
+ *   u64 offset of each section x7:
+ *   symbols       {u32 name, u32 scope, u8 type, 3 zero bytes} each
+ *   scopes        {u32 name, u32 parent} each
+ *   name offsets  u32 x (names + 1)
+ *   name bytes    each name NUL terminated
+ *   symbol index | scope index | name index   {u32 hash, u32 entry + 1} each
+ *
+ *   SymSnapshot s;
+ *   if (snapOpen(&s, "table.syms") != 0) ...
+ *   int entry = snapResolve(&s, "x", 1, snapScope(&s, 0, "main", 4));
+ *   snapClose(&s);
+ *
+ * Only the header and section bounds are checked on open; the contents
+ * are trusted as written by snapSave(). snapLoad() copies a snapshot into
+ * an open lexer of its language, which then goes on entering symbols on
+ * top of it.
+ */
+#include "lexer.h"
+
+#define SNAP_MAGIC "SYMS"
+#define SNAP_VERSION 1
+#define SNAP_BYTE_ORDER 0x01020304u
+
+enum { SNAP_SYMBOLS, SNAP_SCOPES, SNAP_NAME_OFFSETS, SNAP_NAME_BYTES,
+       SNAP_SYMBOL_INDEX, SNAP_SCOPE_INDEX, SNAP_NAME_INDEX, SNAP_SECTIONS };
+
+typedef struct snapHeader {
+    char magic[4];
+    uint32_t version, byteOrder, language;
+    uint32_t symbolCount, scopeCount, nameCount, nameBytes;
+    uint32_t slots[3];       // symbol, scope and name index sizes; 0 or a power of 2
+    uint32_t zero;
+    uint64_t offsets[SNAP_SECTIONS];
+} SnapHeader;
+
+/* The sections are the lexer's arrays as they are. */
+typedef char snapSymbolLayout[sizeof(Symbol) == 12 && sizeof(LexScope) == 8 && sizeof(Slot) == 8 ? 1 : -1];
+
+typedef struct symSnapshot {
+    Source src;              // the mapped file
+    Language lang;
+    const Symbol *symbols;
+    uint32_t symbolCount;
+    const LexScope *scopes;
+    uint32_t scopeCount;
+    StringPool names;        // read-only views of the mapping
+    HashIndex symbolIndex, scopeIndex;
+} SymSnapshot;
+
+typedef struct snapKey {
+    const SymSnapshot *s;
+    uint32_t name, scope;
+} SnapKey;
+
+/* ---------------- WRITER ---------------- */
+static inline uint64_t snapAlign(uint64_t n) {
+    return (n + 7) & ~(uint64_t)7;
+}
+
+static inline uint32_t snapSlots(const HashIndex *hi) {
+    return hi->slots ? hi->mask + 1 : 0;
+}
+
+/* A lexer reused across inputs keeps the slots its largest input needed.
+ * An index with room to spare is saved rebuilt at the size its entries
+ * would have grown it to, so small tables make small snapshots; fit
+ * shares hi's slots when they are already that size. */
+static inline int snapFit(const HashIndex *hi, HashIndex *fit) {
+    uint32_t size = INDEX_MIN_SLOTS;
+    while ((uint64_t)hi->count * 8 > (uint64_t)size * 7) size *= 2;
+    *fit = *hi;
+    if (!hi->slots || hi->mask + 1 <= size) return 0;
+    if (!(fit->slots = calloc(size, sizeof(Slot)))) return -1;
+    fit->mask = size - 1;
+    for (uint32_t i = 0; i <= hi->mask; i++)
+        if (hi->slots[i].entry) hiPlace(fit->slots, fit->mask, hi->slots[i]);
+    return 0;
+}
+
+static inline int snapPad(FILE *fp, uint64_t *at, uint64_t to) {
+    static const char zeros[8];
+    int ok = to - *at < 8 && fwrite(zeros, 1, to - *at, fp) == to - *at;
+    *at = to;
+    return ok;
+}
+
+/* Save lx's symbol table to path; returns 0, or -1 if it cannot be written. */
+static inline int snapSave(const Lexer *lx, const char *path) {
+    const StringPool *p = &lx->names;
+    SnapHeader h;
+    memset(&h, 0, sizeof(h));
+    memcpy(h.magic, SNAP_MAGIC, 4);
+    h.version = SNAP_VERSION;
+    h.byteOrder = SNAP_BYTE_ORDER;
+    h.language = lx->lang;
+    h.symbolCount = lx->symbolCount;
+    h.scopeCount = lx->scopeCount;
+    h.nameCount = p->count;
+    h.nameBytes = p->used;
+    const HashIndex *indexes[3] = { &lx->symbolIndex, &lx->scopeIndex, &p->index };
+    HashIndex fit[3];
+    int ok = 1;
+    for (int i = 0; i < 3; i++) {
+        ok = snapFit(indexes[i], &fit[i]) == 0 && ok;
+        h.slots[i] = snapSlots(&fit[i]);
+    }
+    const void *data[SNAP_SECTIONS] = {
+        lx->symbols, lx->scopes, p->offsets, p->bytes,
+        fit[0].slots, fit[1].slots, fit[2].slots
+    };
+    uint64_t sizes[SNAP_SECTIONS] = {
+        (uint64_t)h.symbolCount * sizeof(Symbol), (uint64_t)h.scopeCount * sizeof(LexScope),
+        (uint64_t)(h.nameCount + 1) * sizeof(uint32_t), h.nameBytes,
+        (uint64_t)h.slots[0] * sizeof(Slot), (uint64_t)h.slots[1] * sizeof(Slot),
+        (uint64_t)h.slots[2] * sizeof(Slot)
+    };
+    uint64_t at = sizeof(h);
+    for (int i = 0; i < SNAP_SECTIONS; i++) {
+        at = snapAlign(at);
+        h.offsets[i] = at;
+        at += sizes[i];
+    }
+
+    FILE *fp = ok ? fopen(path, "wb") : NULL;
+    ok = fp && fwrite(&h, sizeof(h), 1, fp) == 1;
+    at = sizeof(h);
+    for (int i = 0; ok && i < SNAP_SECTIONS; i++) {
+        ok = snapPad(fp, &at, h.offsets[i]);
+        if (i == SNAP_SYMBOLS) {    // copied field by field: no padding garbage on disk
+            Symbol buf[256];
+            for (uint32_t k = 0; ok && k < h.symbolCount; k += 256) {
+                uint32_t n = h.symbolCount - k < 256 ? h.symbolCount - k : 256;
+                memset(buf, 0, sizeof(buf));
+                for (uint32_t j = 0; j < n; j++) {
+                    buf[j].name = lx->symbols[k + j].name;
+                    buf[j].scope = lx->symbols[k + j].scope;
+                    buf[j].type = lx->symbols[k + j].type;
+                }
+                ok = fwrite(buf, sizeof(Symbol), n, fp) == n;
+            }
+        } else if (sizes[i]) {
+            ok = ok && fwrite(data[i], 1, sizes[i], fp) == sizes[i];
+        }
+        at += sizes[i];
+    }
+    if (fp) ok = (fclose(fp) == 0) && ok;
+    for (int i = 0; i < 3; i++)
+        if (fit[i].slots != indexes[i]->slots) free(fit[i].slots);
+    return ok ? 0 : -1;
+}
+
+/* ---------------- READER ---------------- */
+static inline int snapIndexView(HashIndex *hi, const uint8_t *base, uint64_t offset, uint32_t slots, uint32_t count) {
+    if (slots & (slots - 1)) return -1;
+    memset(hi, 0, sizeof(*hi));
+    hi->slots = slots ? (Slot *)(base + offset) : NULL;   // never written through
+    hi->mask = slots ? slots - 1 : 0;
+    hi->count = count;
+    return 0;
+}
+
+/* Map a snapshot. Returns 0 on success, -1 if the file cannot be read, -2
+ * if it is not a snapshot of this version and byte order. */
+static inline int snapOpen(SymSnapshot *s, const char *path) {
+    memset(s, 0, sizeof(*s));
+    if (srcOpen(&s->src, path) != 0) return -1;
+    const uint8_t *base = (const uint8_t *)s->src.data;
+    uint64_t size = s->src.len;
+    SnapHeader h;
+    if (size < sizeof(h)) goto bad;
+    memcpy(&h, base, sizeof(h));
+    if (memcmp(h.magic, SNAP_MAGIC, 4) != 0 || h.version != SNAP_VERSION ||
+        h.byteOrder != SNAP_BYTE_ORDER || h.language >= LANG_COUNT || h.nameCount == 0)
+        goto bad;
+    uint64_t sizes[SNAP_SECTIONS] = {
+        (uint64_t)h.symbolCount * sizeof(Symbol), (uint64_t)h.scopeCount * sizeof(LexScope),
+        (uint64_t)(h.nameCount + 1) * sizeof(uint32_t), h.nameBytes,
+        (uint64_t)h.slots[0] * sizeof(Slot), (uint64_t)h.slots[1] * sizeof(Slot),
+        (uint64_t)h.slots[2] * sizeof(Slot)
+    };
+    for (int i = 0; i < SNAP_SECTIONS; i++)
+        if (h.offsets[i] % 8 || h.offsets[i] > size || sizes[i] > size - h.offsets[i]) goto bad;
+
+    s->lang = h.language;
+    s->symbols = (const Symbol *)(base + h.offsets[SNAP_SYMBOLS]);
+    s->symbolCount = h.symbolCount;
+    s->scopes = (const LexScope *)(base + h.offsets[SNAP_SCOPES]);
+    s->scopeCount = h.scopeCount;
+    s->names.bytes = (char *)(base + h.offsets[SNAP_NAME_BYTES]);
+    s->names.used = s->names.cap = h.nameBytes;
+    s->names.offsets = (uint32_t *)(base + h.offsets[SNAP_NAME_OFFSETS]);
+    s->names.count = h.nameCount;
+    s->names.idCap = h.nameCount + 1;
+    if (s->names.offsets[h.nameCount] != h.nameBytes ||
+        snapIndexView(&s->symbolIndex, base, h.offsets[SNAP_SYMBOL_INDEX], h.slots[0], h.symbolCount) ||
+        snapIndexView(&s->scopeIndex, base, h.offsets[SNAP_SCOPE_INDEX], h.slots[1], h.scopeCount) ||
+        snapIndexView(&s->names.index, base, h.offsets[SNAP_NAME_INDEX], h.slots[2], h.nameCount))
+        goto bad;
+    madvise((void *)s->src.data, s->src.len, MADV_RANDOM);   // lookups, not a scan
+    return 0;
+
+bad:
+    srcClose(&s->src);
+    return -2;
+}
+
+static inline void snapClose(SymSnapshot *s) {
+    srcClose(&s->src);
+    memset(s, 0, sizeof(*s));
+}
+
+static inline const char *snapName(const SymSnapshot *s, uint32_t name) {
+    return poolString(&s->names, name);
+}
+
+/* Id of a name, or -1 if nothing in the snapshot is called that. */
+static inline int snapNameId(const SymSnapshot *s, const char *name, int len) {
+    PoolKey key = { &s->names, name, len };
+    return hiFind(&s->names.index, hashBytes(name, len), poolMatches, &key);
+}
+
+static inline int snapSymbolMatches(const void *key, uint32_t entry) {
+    const SnapKey *k = key;
+    const Symbol *sym = &k->s->symbols[entry];
+    return sym->name == k->name && sym->scope == k->scope;
+}
+
+static inline int snapScopeMatches(const void *key, uint32_t id) {
+    const SnapKey *k = key;
+    const LexScope *sc = &k->s->scopes[id];
+    return sc->name == k->name && sc->parent == k->scope;
+}
+
+/* Symbol entry of name in exactly this scope, or -1. */
+static inline int snapFind(const SymSnapshot *s, const char *name, int len, uint32_t scope) {
+    SnapKey key = { s, 0, scope };
+    int id = snapNameId(s, name, len);
+    if (id < 0) return -1;
+    key.name = id;
+    return hiFind(&s->symbolIndex, lexSymbolHash(key.name, scope), snapSymbolMatches, &key);
+}
+
+/* Symbol entry name resolves to from scope, innermost scope first, or -1. */
+static inline int snapResolve(const SymSnapshot *s, const char *name, int len, uint32_t scope) {
+    SnapKey key = { s, 0, scope };
+    int id = snapNameId(s, name, len);
+    if (id < 0) return -1;
+    key.name = id;
+    for (;;) {
+        int found = hiFind(&s->symbolIndex, lexSymbolHash(key.name, key.scope), snapSymbolMatches, &key);
+        if (found >= 0 || key.scope == 0) return found;
+        key.scope = s->scopes[key.scope].parent;
+    }
+}
+
+/* Id of the scope named name directly inside parent (0 is Global), or -1. */
+static inline int snapScope(const SymSnapshot *s, uint32_t parent, const char *name, int len) {
+    SnapKey key = { s, 0, parent };
+    int id = snapNameId(s, name, len);
+    if (id < 0) return -1;
+    key.name = id;
+    return hiFind(&s->scopeIndex, lexSymbolHash(key.name, parent), snapScopeMatches, &key);
+}
+
+/* ---------------- LOADING ---------------- */
+static inline void *snapDup(const void *p, size_t n) {
+    void *copy = malloc(n ? n : 1);
+    if (copy && n) memcpy(copy, p, n);
+    return copy;
+}
+
+/* Replace lx's symbol table with a copy of the snapshot's and go on from
+ * its Global scope. lx must be open on the snapshot's language. Returns 0,
+ * or -1 (table unchanged) if the language differs or memory runs out. */
+static inline int snapLoad(Lexer *lx, const SymSnapshot *s) {
+    if (lx->lang != s->lang) return -1;
+    size_t symbolSlots = s->symbolIndex.slots ? (size_t)(s->symbolIndex.mask + 1) * sizeof(Slot) : 0;
+    size_t scopeSlots = s->scopeIndex.slots ? (size_t)(s->scopeIndex.mask + 1) * sizeof(Slot) : 0;
+    size_t nameSlots = s->names.index.slots ? (size_t)(s->names.index.mask + 1) * sizeof(Slot) : 0;
+    Symbol *symbols = snapDup(s->symbols, (size_t)s->symbolCount * sizeof(Symbol));
+    LexScope *scopes = snapDup(s->scopes, (size_t)s->scopeCount * sizeof(LexScope));
+    char *bytes = snapDup(s->names.bytes, s->names.used);
+    uint32_t *offsets = snapDup(s->names.offsets, (size_t)(s->names.count + 1) * sizeof(uint32_t));
+    Slot *slots[3] = { snapDup(s->symbolIndex.slots, symbolSlots), snapDup(s->scopeIndex.slots, scopeSlots),
+                       snapDup(s->names.index.slots, nameSlots) };
+    if (!symbols || !scopes || !bytes || !offsets || !slots[0] || !slots[1] || !slots[2]) {
+        free(symbols); free(scopes); free(bytes); free(offsets);
+        free(slots[0]); free(slots[1]); free(slots[2]);
+        return -1;
+    }
+
+    /* Each index keeps its own counters (-DSYMTAB_STATS); only the slots move. */
+    HashIndex *to[3] = { &lx->symbolIndex, &lx->scopeIndex, &lx->names.index };
+    const HashIndex *from[3] = { &s->symbolIndex, &s->scopeIndex, &s->names.index };
+    size_t sizes[3] = { symbolSlots, scopeSlots, nameSlots };
+    for (int i = 0; i < 3; i++) {
+        free(to[i]->slots);
+        to[i]->slots = sizes[i] ? slots[i] : NULL;
+        to[i]->mask = from[i]->mask;
+        to[i]->count = from[i]->count;
+        if (!sizes[i]) free(slots[i]);
+    }
+    free(lx->symbols);
+    lx->symbols = symbols;
+    lx->symbolCount = lx->symbolCap = s->symbolCount;
+    free(lx->scopes);
+    lx->scopes = scopes;
+    lx->scopeCount = lx->scopeCap = s->scopeCount;
+    free(lx->names.bytes);
+    lx->names.bytes = bytes;
+    lx->names.used = lx->names.cap = s->names.used;
+    free(lx->names.offsets);
+    lx->names.offsets = offsets;
+    lx->names.count = s->names.count;
+    lx->names.idCap = s->names.count + 1;
+    lx->globalScope = lx->scope = 0;
+    lx->inHeader = 0;
+    return 0;
+}
+
+#endif
@@ -0,0 +1,162 @@
+#ifndef SYMTAB_H
+#define SYMTAB_H
+
+/* ================= SYMBOL INDEX =================
+ * Open-addressing hash index used by the lexers' symbol tables. The slots
+ * are one flat array of (hash, entry number) pairs kept in Robin Hood
+ * order, so a probe walks adjacent memory and stops as soon as it meets a
+ * slot closer to its home than the key would be. The array doubles when it
+ * is 7/8 full. Records stay in the caller's own array in insertion order;
+ * the index only maps hashes to positions in it.
+ *
+ * Built with -DSYMTAB_STATS, every index also counts its lookups, probes,
+ * inserts and grows, and hiReport() prints them with the spread of probe
+ * distances. Without it SYMSTAT() statements compile to nothing.
+ */
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define INDEX_MIN_SLOTS 64
+
+#ifdef SYMTAB_STATS
+#include <stdio.h>
+#define SYMSTAT(x) x
+
+typedef struct hashCounters {
+    uint64_t lookups, hits;  // hiFind calls, and those that found the key
+    uint64_t probes;         // slots examined by them
+    uint64_t inserts, grows;
+} HashCounters;
+#else
+#define SYMSTAT(x)
+#endif
+
+typedef struct slot {
+    uint32_t hash;
+    uint32_t entry;      // entry number + 1, 0 = empty slot
+} Slot;
+
+typedef struct hashIndex {
+    Slot *slots;
+    uint32_t mask;       // number of slots - 1
+    uint32_t count;      // occupied slots
+#ifdef SYMTAB_STATS
+    HashCounters counters;   // kept across hiClear()
+#endif
+} HashIndex;
+
+/* Returns non-zero if caller's entry number `entry` equals `key`. */
+typedef int (*EntryMatch)(const void *key, uint32_t entry);
+
+/* 64-bit multiply-xorshift over 8-byte words, folded to 32 bits. */
+static inline uint32_t hashBytes(const char *s, int len) {
+    uint64_t h = 0x9E3779B97F4A7C15ull ^ (uint64_t)len;
+    while (len >= 8) {
+        uint64_t w;
+        memcpy(&w, s, 8);
+        h = (h ^ w) * 0xFF51AFD7ED558CCDull;
+        h ^= h >> 32;
+        s += 8; len -= 8;
+    }
+    uint64_t w = 0;
+    memcpy(&w, s, len);
+    h = (h ^ w) * 0xC4CEB9FE1A85EC53ull;
+    h ^= h >> 29;
+    return (uint32_t)(h ^ (h >> 32));
+}
+
+/* Entry number of the key with this hash, or -1 if it is not indexed. */
+static inline int hiFind(const HashIndex *hi, uint32_t hash, EntryMatch match, const void *key) {
+    SYMSTAT(HashCounters *c = (HashCounters *)&hi->counters; c->lookups++;)
+    if (!hi->slots) return -1;
+    uint32_t pos = hash & hi->mask;
+    for (uint32_t dist = 0;; dist++, pos = (pos + 1) & hi->mask) {
+        const Slot *s = &hi->slots[pos];
+        SYMSTAT(c->probes++;)
+        if (!s->entry || ((pos - s->hash) & hi->mask) < dist) return -1;
+        if (s->hash == hash && match(key, s->entry - 1)) {
+            SYMSTAT(c->hits++;)
+            return s->entry - 1;
+        }
+    }
+}
+
+static void hiPlace(Slot *slots, uint32_t mask, Slot in) {
+    uint32_t pos = in.hash & mask;
+    for (uint32_t dist = 0;; dist++, pos = (pos + 1) & mask) {
+        Slot *s = &slots[pos];
+        if (!s->entry) { *s = in; return; }
+        uint32_t d = (pos - s->hash) & mask;
+        if (d < dist) {   // resident is richer: take its slot, carry it on
+            Slot t = *s; *s = in; in = t;
+            dist = d;
+        }
+    }
+}
+
+static int hiGrow(HashIndex *hi) {
+    uint32_t size = hi->slots ? (hi->mask + 1) * 2 : INDEX_MIN_SLOTS;
+    Slot *slots = calloc(size, sizeof(Slot));
+    if (!slots) return -1;
+    for (uint32_t i = 0; hi->slots && i <= hi->mask; i++)
+        if (hi->slots[i].entry) hiPlace(slots, size - 1, hi->slots[i]);
+    free(hi->slots);
+    hi->slots = slots;
+    hi->mask = size - 1;
+    SYMSTAT(hi->counters.grows++;)
+    return 0;
+}
+
+/* Index a new entry; the caller has already checked it is not present. */
+static int hiInsert(HashIndex *hi, uint32_t hash, uint32_t entry) {
+    if (!hi->slots || (uint64_t)(hi->count + 1) * 8 > (uint64_t)(hi->mask + 1) * 7)
+        if (hiGrow(hi) != 0) return -1;
+    Slot in = { hash, entry + 1 };
+    hiPlace(hi->slots, hi->mask, in);
+    hi->count++;
+    SYMSTAT(hi->counters.inserts++;)
+    return 0;
+}
+
+/* Drop every entry but keep the slots for reuse. */
+static inline void hiClear(HashIndex *hi) {
+    if (hi->slots) memset(hi->slots, 0, (hi->mask + 1) * sizeof(Slot));
+    hi->count = 0;
+}
+
+static inline void hiFree(HashIndex *hi) {
+    free(hi->slots);
+    memset(hi, 0, sizeof(*hi));
+}
+
+#ifdef SYMTAB_STATS
+/* Occupancy, probe distances (how far each key sits from its home slot,
+ * the open addressing counterpart of chain length) and the counters. */
+static void hiReport(FILE *fp, const char *title, const HashIndex *hi) {
+    static const char *bands[] = { "0", "1", "2", "3", "4-7", "8-15", "16-31", "32+" };
+    uint64_t hist[8] = { 0 }, total = 0;
+    uint32_t slots = hi->slots ? hi->mask + 1 : 0, longest = 0;
+    for (uint32_t pos = 0; pos < slots; pos++) {
+        const Slot *s = &hi->slots[pos];
+        if (!s->entry) continue;
+        uint32_t d = (pos - s->hash) & hi->mask;
+        int band = d < 4 ? (int)d : d < 8 ? 4 : d < 16 ? 5 : d < 32 ? 6 : 7;
+        hist[band]++;
+        total += d;
+        if (d > longest) longest = d;
+    }
+    const HashCounters *c = &hi->counters;
+    fprintf(fp, "%s: %u slots, %u used (%.1f%% load), %zu bytes\n", title, slots, hi->count,
+            slots ? 100.0 * hi->count / slots : 0.0, (size_t)slots * sizeof(Slot));
+    fprintf(fp, "  probe distance");
+    for (int i = 0; i < 8; i++) fprintf(fp, "  %s: %llu", bands[i], (unsigned long long)hist[i]);
+    fprintf(fp, "\n  longest %u, mean %.2f\n", longest, hi->count ? (double)total / hi->count : 0.0);
+    fprintf(fp, "  %llu lookups, %.2f probes each, %.1f%% found; %llu inserts, %llu grows\n",
+            (unsigned long long)c->lookups, c->lookups ? (double)c->probes / c->lookups : 0.0,
+            c->lookups ? 100.0 * c->hits / c->lookups : 0.0,
+            (unsigned long long)c->inserts, (unsigned long long)c->grows);
+}
+#endif
+
+#endif
@@ -0,0 +1,299 @@
+#ifndef TOKCACHE_H
+#define TOKCACHE_H
+
+/* ================= TOKEN CACHE =================
+ * On-disk cache of lexing results, so that a batch run over a tree that
+ * has barely changed replays what it lexed last time instead of lexing
+ * again. An entry is keyed by everything its results depend on: a 128-bit
+ * hash and the length of the input, the language and LEXER_VERSION. It is
+ * two files in the cache directory named after the key, the token stream
+ * as a token file (tokstore.h) and the symbol table as a snapshot
+ * (symsnap.h), so a hit maps both and lexes nothing.
+ *
+ *   TokenCache tc;
+ *   char key[TC_KEY];
+ *   tcOpen(&tc, ".lexcache", 256000000);
+ *   tcKey(key, data, len, lang);
+ *   if (tcLookup(&tc, key, &tokens, &symbols)) ... replay, then close both
+ *   else  tcStoreBegin(), twAppend() every token, tcStoreEnd()
+ *   tcTrim(&tc);
+ *   tcReport(&tc, stderr);
+ *
+ * Entries are written under temporary names and renamed into place, the
+ * snapshot first, so a run never sees half an entry; a lookup that finds
+ * only one file is a miss, and storing again repairs it. Runs sharing a
+ * cache directory are safe for the same reason.
+ *
+ * Eviction is least recently used, with file modification times as the
+ * clock: a hit touches both files, and tcTrim() deletes the oldest entries
+ * until the cache fits its size limit. It runs between batches, so the
+ * cache can outgrow the limit by what one run stores. The counters are
+ * updated atomically, so workers can share one TokenCache.
+ *
+ * The content hash is not cryptographic; it only has to tell apart the
+ * revisions of files that share a cache.
+ */
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <dirent.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include "tokstore.h"
+#include "symsnap.h"
+
+#define TC_KEY 64                  // 32 hex digits of hash, length, language, version
+#define TC_PATH 4096
+#define TC_STALE_TEMP (60 * 60)    // seconds before tcTrim() removes a crashed run's temporaries
+
+typedef struct tokenCache {
+    const char *dir;
+    uint64_t limit;                // bytes; 0 for no limit
+    uint64_t hits, misses, stores, storeFailures;
+    uint64_t evictions, evictedBytes;
+    uint64_t entries, bytes;       // what is left after the last tcTrim()
+    uint32_t temps;                // names temporaries apart
+} TokenCache;
+
+typedef struct cacheStore {
+    TokenWriter w;
+    char key[TC_KEY];
+    char tokPath[TC_PATH], symPath[TC_PATH];
+} CacheStore;
+
+/* ---------------- KEYS ---------------- */
+static inline uint64_t tcMix(uint64_t h) {
+    h ^= h >> 33;
+    h *= 0xFF51AFD7ED558CCDull;
+    h ^= h >> 33;
+    h *= 0xC4CEB9FE1A85EC53ull;
+    return h ^ (h >> 33);
+}
+
+static inline uint64_t tcRotate(uint64_t v, int r) {
+    return (v << r) | (v >> (64 - r));
+}
+
+/* Two 64-bit lanes over 16-byte blocks, each folded into the other so
+ * every input bit reaches both halves. */
+static inline void tcHash(const char *s, size_t len, uint64_t out[2]) {
+    uint64_t a = 0x9E3779B97F4A7C15ull ^ len, b = 0xC2B2AE3D27D4EB4Full + len;
+    size_t n = len;
+    while (n >= 16) {
+        uint64_t x, y;
+        memcpy(&x, s, 8);
+        memcpy(&y, s + 8, 8);
+        a = tcRotate(a ^ (x * 0x87C37B91114253D5ull), 31) * 5 + b;
+        b = tcRotate(b ^ (y * 0x4CF5AD432745937Full), 33) * 5 + a;
+        s += 16; n -= 16;
+    }
+    uint64_t x = 0, y = 0;
+    memcpy(&x, s, n < 8 ? n : 8);
+    if (n > 8) memcpy(&y, s + 8, n - 8);
+    a ^= x * 0x87C37B91114253D5ull;
+    b ^= y * 0x4CF5AD432745937Full;
+    a += b; b += a;
+    a = tcMix(a); b = tcMix(b);
+    a += b; b += a;
+    out[0] = a;
+    out[1] = b;
+}
+
+/* The entry name for len bytes of lang at data. */
+static inline void tcKey(char key[TC_KEY], const char *data, size_t len, Language lang) {
+    uint64_t h[2];
+    tcHash(data, len, h);
+    snprintf(key, TC_KEY, "%016llx%016llx-%llx-%d-v%d", (unsigned long long)h[0],
+             (unsigned long long)h[1], (unsigned long long)len, (int)lang, LEXER_VERSION);
+}
+
+static inline int tcPath(char *path, const TokenCache *tc, const char *name, const char *ext) {
+    int n = snprintf(path, TC_PATH, "%s/%s%s", tc->dir, name, ext);
+    return n > 0 && n < TC_PATH ? 0 : -1;
+}
+
+/* ---------------- LOOKUP ---------------- */
+
+/* Open the cache in dir, creating the directory if need be; limit is in
+ * bytes, 0 for none. Returns 0, or -1 if dir cannot be used. */
+static inline int tcOpen(TokenCache *tc, const char *dir, uint64_t limit) {
+    memset(tc, 0, sizeof(*tc));
+    tc->dir = dir;
+    tc->limit = limit;
+    if (mkdir(dir, 0777) != 0 && errno != EEXIST) return -1;
+    return access(dir, R_OK | W_OK | X_OK) == 0 ? 0 : -1;
+}
+
+/* Map the entry for key. Returns 1 on a hit, with tokens and symbols
+ * open for the caller to close, 0 on a miss. */
+static inline int tcLookup(TokenCache *tc, const char *key, TokenFile *tokens, SymSnapshot *symbols) {
+    char tokPath[TC_PATH], symPath[TC_PATH];
+    if (tcPath(tokPath, tc, key, ".tok") == 0 && tcPath(symPath, tc, key, ".sym") == 0 &&
+        tfOpen(tokens, tokPath) == 0) {
+        if (snapOpen(symbols, symPath) == 0) {
+            utimensat(AT_FDCWD, tokPath, NULL, 0);
+            utimensat(AT_FDCWD, symPath, NULL, 0);
+            __atomic_fetch_add(&tc->hits, 1, __ATOMIC_RELAXED);
+            return 1;
+        }
+        tfClose(tokens);
+    }
+    __atomic_fetch_add(&tc->misses, 1, __ATOMIC_RELAXED);
+    return 0;
+}
+
+/* ---------------- STORING ---------------- */
+
+/* Start the entry for key; tokens go to st->w with twAppend(), offsets
+ * relative to base. Returns 0, or -1 if nothing can be stored. */
+static inline int tcStoreBegin(TokenCache *tc, CacheStore *st, const char *key, const char *base) {
+    char ext[64];
+    long pid = (long)getpid();
+    unsigned temp = __atomic_fetch_add(&tc->temps, 1, __ATOMIC_RELAXED);
+    snprintf(st->key, TC_KEY, "%s", key);
+    snprintf(ext, sizeof(ext), ".tmp%ld-%u.tok", pid, temp);
+    int bad = tcPath(st->tokPath, tc, key, ext);
+    snprintf(ext, sizeof(ext), ".tmp%ld-%u.sym", pid, temp);
+    bad |= tcPath(st->symPath, tc, key, ext);
+    if (bad || twOpen(&st->w, st->tokPath, base) != 0) {
+        __atomic_fetch_add(&tc->storeFailures, 1, __ATOMIC_RELAXED);
+        return -1;
+    }
+    return 0;
+}
+
+/* Finish the entry with lx's symbol table and move it into place. Returns
+ * 0, or -1 if it was dropped. */
+static inline int tcStoreEnd(TokenCache *tc, CacheStore *st, const Lexer *lx) {
+    char tokPath[TC_PATH], symPath[TC_PATH];
+    int ok = twClose(&st->w) == 0 && snapSave(lx, st->symPath) == 0 &&
+             tcPath(tokPath, tc, st->key, ".tok") == 0 && tcPath(symPath, tc, st->key, ".sym") == 0 &&
+             rename(st->symPath, symPath) == 0 && rename(st->tokPath, tokPath) == 0;
+    if (!ok) {
+        unlink(st->tokPath);
+        unlink(st->symPath);
+        __atomic_fetch_add(&tc->storeFailures, 1, __ATOMIC_RELAXED);
+        return -1;
+    }
+    __atomic_fetch_add(&tc->stores, 1, __ATOMIC_RELAXED);
+    return 0;
+}
+
+/* ---------------- EVICTION ---------------- */
+typedef struct cacheFile {
+    char *name;
+    struct timespec used;
+    uint64_t bytes;
+} CacheFile;
+
+static inline int tcCompareNames(const void *a, const void *b) {
+    return strcmp(((const CacheFile *)a)->name, ((const CacheFile *)b)->name);
+}
+
+/* Least recently used first; ties by name so the order is stable. */
+static inline int tcCompareUse(const void *a, const void *b) {
+    const CacheFile *x = a, *y = b;
+    if (x->used.tv_sec != y->used.tv_sec) return x->used.tv_sec < y->used.tv_sec ? -1 : 1;
+    if (x->used.tv_nsec != y->used.tv_nsec) return x->used.tv_nsec < y->used.tv_nsec ? -1 : 1;
+    return strcmp(x->name, y->name);
+}
+
+/* Delete the least recently used entries until the cache fits its limit,
+ * and any temporary a crashed run left behind. An entry's files are paired
+ * by name, the token file goes first so the entry stops hitting at once,
+ * and a file whose partner is missing counts as an entry of its own.
+ * Returns 0, or -1 if the directory cannot be read. */
+static inline int tcTrim(TokenCache *tc) {
+    DIR *d = opendir(tc->dir);
+    if (!d) return -1;
+    CacheFile *files = NULL;
+    size_t n = 0, cap = 0;
+    time_t now = time(NULL);
+    struct dirent *e;
+    while ((e = readdir(d)) != NULL) {
+        size_t len = strlen(e->d_name);
+        char path[TC_PATH];
+        struct stat st;
+        if (len < 5 || tcPath(path, tc, e->d_name, "") != 0 || stat(path, &st) != 0 ||
+            !S_ISREG(st.st_mode))
+            continue;
+        if (strstr(e->d_name, ".tmp")) {
+            if (now - st.st_mtime > TC_STALE_TEMP) unlink(path);
+            continue;
+        }
+        if (strcmp(e->d_name + len - 4, ".tok") != 0 && strcmp(e->d_name + len - 4, ".sym") != 0)
+            continue;
+        if (n == cap) {
+            cap = cap ? cap * 2 : 256;
+            files = realloc(files, cap * sizeof(CacheFile));
+        }
+        files[n].name = strdup(e->d_name);
+        files[n].used = st.st_mtim;
+        files[n].bytes = (uint64_t)st.st_size;
+        n++;
+    }
+    closedir(d);
+
+    /* Fold each pair into its first file: the key with the later use and
+     * the sum of the sizes. Names sort ".sym" before ".tok". */
+    qsort(files, n, sizeof(CacheFile), tcCompareNames);
+    size_t entries = 0;
+    uint64_t total = 0;
+    for (size_t i = 0; i < n; i++) {
+        CacheFile f = files[i];
+        size_t keyLen = strlen(f.name) - 4;
+        if (i + 1 < n && strlen(files[i + 1].name) == keyLen + 4 &&
+            memcmp(files[i + 1].name, f.name, keyLen) == 0) {
+            CacheFile g = files[++i];
+            if (tcCompareUse(&g, &f) > 0) f.used = g.used;
+            f.bytes += g.bytes;
+            free(g.name);
+        }
+        f.name[keyLen] = '\0';
+        files[entries++] = f;
+        total += f.bytes;
+    }
+
+    qsort(files, entries, sizeof(CacheFile), tcCompareUse);
+    size_t kept = 0;
+    for (size_t i = 0; i < entries; i++) {
+        char tokPath[TC_PATH], symPath[TC_PATH];
+        if (tc->limit && total > tc->limit &&
+            tcPath(tokPath, tc, files[i].name, ".tok") == 0 &&
+            tcPath(symPath, tc, files[i].name, ".sym") == 0) {
+            unlink(tokPath);
+            unlink(symPath);
+            total -= files[i].bytes;
+            tc->evictions++;
+            tc->evictedBytes += files[i].bytes;
+        } else {
+            kept++;
+        }
+        free(files[i].name);
+    }
+    free(files);
+    tc->entries = kept;
+    tc->bytes = total;
+    return 0;
+}
+
+/* ---------------- REPORT ---------------- */
+static inline void tcReport(const TokenCache *tc, FILE *fp) {
+    uint64_t lookups = tc->hits + tc->misses;
+    fprintf(fp, "cache %s: %llu hits, %llu misses (%.1f%% hit rate), %llu stored",
+            tc->dir, (unsigned long long)tc->hits, (unsigned long long)tc->misses,
+            lookups ? 100.0 * tc->hits / lookups : 0.0, (unsigned long long)tc->stores);
+    if (tc->storeFailures)
+        fprintf(fp, ", %llu not stored", (unsigned long long)tc->storeFailures);
+    fprintf(fp, ", %llu evicted (%.1f MB); %llu entries, %.1f MB",
+            (unsigned long long)tc->evictions, tc->evictedBytes / 1e6,
+            (unsigned long long)tc->entries, tc->bytes / 1e6);
+    if (tc->limit) fprintf(fp, " of %.1f MB", tc->limit / 1e6);
+    fputc('\n', fp);
+}
+
+#endif
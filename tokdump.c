@@ -0,0 +1,58 @@
+#include <stdio.h>
+#include <string.h>
+#include "tokstore.h"
+#include "outbuf.h"
+
+/* Print a token file written by a lexer's -b option, one token per line.
+ * With the source file as well, the lexeme text is shown; without it, its
+ * byte offset and length.
+ *
+ *   ./sql -b tokens.bin && ./tokdump tokens.bin input.sql
+ */
+int main(int argc, char **argv) {
+    if (argc < 2 || argc > 3) {
+        printf("usage: %s tokens.bin [source]\n", argv[0]);
+        return 1;
+    }
+
+    TokenFile tf;
+    int rc = tfOpen(&tf, argv[1]);
+    if (rc == -1) { printf("Cannot open %s\n", argv[1]); return 1; }
+    if (rc == -2) { printf("%s is not a token file\n", argv[1]); return 1; }
+
+    Source src = {0};
+    if (argc == 3 && srcOpen(&src, argv[2]) != 0) {
+        printf("Cannot open %s\n", argv[2]);
+        return 1;
+    }
+
+    static OutBuf out;
+    TokenCursor cur;
+    TokenRecord t;
+    outOpen(&out, STDOUT_FILENO);
+    tfBegin(&tf, &cur);
+    while ((rc = tfNext(&cur, &t)) == 1) {
+        outChar(&out, '<');
+        outStr(&out, t.kind < TOK_KIND_COUNT ? tokenKindNames[t.kind] : "?");
+        outChar(&out, ',');
+        if (src.data && t.offset + t.length <= src.len) {
+            outSpan(&out, src.data + t.offset, (int)t.length);
+        } else {
+            outChar(&out, '@');
+            outU64(&out, t.offset);
+            outChar(&out, '+');
+            outU64(&out, t.length);
+        }
+        outChar(&out, ',');
+        outU64(&out, t.line);
+        outChar(&out, ',');
+        outU64(&out, t.column);
+        outStr(&out, ">\n");
+    }
+    outFlush(&out);
+    if (rc < 0) printf("%s is corrupt after %llu tokens\n", argv[1], (unsigned long long)cur.index);
+
+    srcClose(&src);
+    tfClose(&tf);
+    return rc < 0;
+}
@@ -0,0 +1,35 @@
+#ifndef TOKEN_H
+#define TOKEN_H
+
+/* ================= TOKEN KINDS =================
+ * Shared by every lexer and by the token file format. Each lexer prints
+ * these under its own spelling (ID, NUM, SYM, ...); tokenKindNames holds
+ * the canonical ones used by tools. Token files store kinds by number, so
+ * new kinds go at the end.
+ */
+typedef enum tokenKind {
+    TOK_KEYWORD,
+    TOK_IDENTIFIER,
+    TOK_FUNC,
+    TOK_NUMBER,
+    TOK_STRING,
+    TOK_CHAR,
+    TOK_OP,
+    TOK_DELIM,
+    TOK_PREPROC,
+    TOK_INVALID,
+    TOK_EOF,
+    TOK_DOCSTRING,       // a triple-quoted string starting a logical line
+    TOK_NEWLINE,         // end of a logical line, in a layout language; no text
+    TOK_INDENT,          // a block opens; the text is the new indentation (indent.h)
+    TOK_DEDENT,          // a block closes (indent.h)
+    TOK_KIND_COUNT
+} TokenKind;
+
+static const char *const tokenKindNames[TOK_KIND_COUNT] = {
+    "KEYWORD", "IDENTIFIER", "FUNC", "NUMBER", "STRING", "CHAR",
+    "OP", "DELIM", "PREPROC", "INVALID", "EOF", "DOCSTRING",
+    "NEWLINE", "INDENT", "DEDENT"
+};
+
+#endif
@@ -0,0 +1,278 @@
+#ifndef TOKSTORE_H
+#define TOKSTORE_H
+
+/* ================= TOKEN FILE =================
+ * Binary, column-oriented token store written by the lexers' -b option.
+ * Every token has a kind, the byte offset and length of its lexeme in the
+ * input, and its line and column. Each field is stored as its own column so
+ * a reader only touches what it needs:
+ *
+ *   kind     1 byte per token
+ *   offset   zigzag varint of the delta from the previous token's offset
+ *   length   varint
+ *   line     zigzag varint of the delta from the previous token's line
+ *   column   varint
+ *
+ * File layout (all integers little-endian):
+ *
+ *   "TOKS"  u32 version  u64 token count  u64 byte size of each column x5
+ *   kind column | offset column | length column | line column | column column
+ */
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include "lexinput.h"
+#include "token.h"
+
+#define TS_MAGIC "TOKS"
+#define TS_VERSION 1
+#define TS_HEADER_SIZE (4 + 4 + 8 + 8 * TS_COLUMNS)
+
+enum { TS_KIND, TS_OFFSET, TS_LENGTH, TS_LINE, TS_COLUMN, TS_COLUMNS };
+
+typedef struct byteBuf {
+    uint8_t *data;
+    size_t len, cap;
+} ByteBuf;
+
+/* ---------------- ENCODING ---------------- */
+static inline void bbReserve(ByteBuf *b, size_t n) {
+    if (b->len + n <= b->cap) return;
+    while (b->len + n > b->cap) b->cap = b->cap ? b->cap * 2 : 65536;
+    b->data = realloc(b->data, b->cap);
+}
+
+static inline void bbPutVarint(ByteBuf *b, uint64_t v) {
+    bbReserve(b, 10);
+    while (v >= 0x80) {
+        b->data[b->len++] = (uint8_t)v | 0x80;
+        v >>= 7;
+    }
+    b->data[b->len++] = (uint8_t)v;
+}
+
+static inline uint64_t zigzag(int64_t v) {
+    return ((uint64_t)v << 1) ^ (uint64_t)(v >> 63);
+}
+
+static inline int64_t unzigzag(uint64_t v) {
+    return (int64_t)(v >> 1) ^ -(int64_t)(v & 1);
+}
+
+/* Decode one varint from [p, end); NULL if it runs past end. */
+static inline const uint8_t *getVarint(const uint8_t *p, const uint8_t *end, uint64_t *v) {
+    uint64_t x = 0;
+    for (int shift = 0; p < end && shift < 64; shift += 7) {
+        uint8_t byte = *p++;
+        x |= (uint64_t)(byte & 0x7f) << shift;
+        if (!(byte & 0x80)) { *v = x; return p; }
+    }
+    return NULL;
+}
+
+static inline void putLE(uint8_t *p, uint64_t v, int bytes) {
+    for (int i = 0; i < bytes; i++) p[i] = (uint8_t)(v >> (8 * i));
+}
+
+static inline uint64_t getLE(const uint8_t *p, int bytes) {
+    uint64_t v = 0;
+    for (int i = 0; i < bytes; i++) v |= (uint64_t)p[i] << (8 * i);
+    return v;
+}
+
+/* ---------------- WRITER ---------------- */
+typedef struct tokenWriter {
+    FILE *fp;
+    const char *base;        // start of the input; offsets are relative to it
+    ByteBuf cols[TS_COLUMNS];
+    uint64_t count;
+    uint64_t lastOffset;
+    uint32_t lastLine;
+} TokenWriter;
+
+static inline int twOpen(TokenWriter *w, const char *path, const char *base) {
+    memset(w, 0, sizeof(*w));
+    w->fp = fopen(path, "wb");
+    if (!w->fp) return -1;
+    w->base = base;
+    return 0;
+}
+
+static inline void twAppend(TokenWriter *w, TokenKind kind, Lexeme lx, int line, int col) {
+    uint64_t offset = lx.ptr - w->base;
+    bbReserve(&w->cols[TS_KIND], 1);
+    w->cols[TS_KIND].data[w->cols[TS_KIND].len++] = (uint8_t)kind;
+    bbPutVarint(&w->cols[TS_OFFSET], zigzag((int64_t)(offset - w->lastOffset)));
+    bbPutVarint(&w->cols[TS_LENGTH], (uint64_t)lx.len);
+    bbPutVarint(&w->cols[TS_LINE], zigzag((int64_t)line - (int64_t)w->lastLine));
+    bbPutVarint(&w->cols[TS_COLUMN], (uint64_t)col);
+    w->lastOffset = offset;
+    w->lastLine = line;
+    w->count++;
+}
+
+/* Write the header and the columns; returns 0 on success. */
+static inline int twClose(TokenWriter *w) {
+    uint8_t header[TS_HEADER_SIZE];
+    memcpy(header, TS_MAGIC, 4);
+    putLE(header + 4, TS_VERSION, 4);
+    putLE(header + 8, w->count, 8);
+    for (int i = 0; i < TS_COLUMNS; i++)
+        putLE(header + 16 + 8 * i, w->cols[i].len, 8);
+
+    int ok = fwrite(header, 1, sizeof(header), w->fp) == sizeof(header);
+    for (int i = 0; i < TS_COLUMNS; i++) {
+        if (w->cols[i].len)
+            ok = ok && fwrite(w->cols[i].data, 1, w->cols[i].len, w->fp) == w->cols[i].len;
+        free(w->cols[i].data);
+    }
+    ok = (fclose(w->fp) == 0) && ok;
+    memset(w, 0, sizeof(*w));
+    return ok ? 0 : -1;
+}
+
+/* ---------------- READER ---------------- */
+typedef struct tokenFile {
+    Source src;              // the mapped file
+    uint64_t count;
+    const uint8_t *cols[TS_COLUMNS];
+    const uint8_t *ends[TS_COLUMNS];
+} TokenFile;
+
+typedef struct tokenRecord {
+    TokenKind kind;
+    uint64_t offset;
+    uint32_t length;
+    uint32_t line;
+    uint32_t column;
+} TokenRecord;
+
+typedef struct tokenCursor {
+    uint64_t index, count;
+    const uint8_t *p[TS_COLUMNS];
+    const uint8_t *end[TS_COLUMNS];
+    uint64_t offset;
+    uint32_t line;
+} TokenCursor;
+
+/* Returns 0 on success, -1 if the file cannot be read, -2 if it is not a
+ * token file of this version. */
+static inline int tfOpen(TokenFile *f, const char *path) {
+    memset(f, 0, sizeof(*f));
+    if (srcOpen(&f->src, path) != 0) return -1;
+
+    const uint8_t *p = (const uint8_t *)f->src.data;
+    uint64_t size = f->src.len, at = TS_HEADER_SIZE;
+    if (size < TS_HEADER_SIZE || memcmp(p, TS_MAGIC, 4) != 0 || getLE(p + 4, 4) != TS_VERSION) {
+        srcClose(&f->src);
+        return -2;
+    }
+    f->count = getLE(p + 8, 8);
+    for (int i = 0; i < TS_COLUMNS; i++) {
+        uint64_t len = getLE(p + 16 + 8 * i, 8);
+        if (len > size - at) { srcClose(&f->src); return -2; }
+        f->cols[i] = p + at;
+        f->ends[i] = p + at + len;
+        at += len;
+    }
+    if ((uint64_t)(f->ends[TS_KIND] - f->cols[TS_KIND]) != f->count) {
+        srcClose(&f->src);
+        return -2;
+    }
+    return 0;
+}
+
+static inline void tfClose(TokenFile *f) {
+    srcClose(&f->src);
+    memset(f, 0, sizeof(*f));
+}
+
+static inline void tfBegin(const TokenFile *f, TokenCursor *c) {
+    memset(c, 0, sizeof(*c));
+    c->count = f->count;
+    for (int i = 0; i < TS_COLUMNS; i++) {
+        c->p[i] = f->cols[i];
+        c->end[i] = f->ends[i];
+    }
+}
+
+/* Decode the next token; returns 1 on success, 0 at the end, -1 if the
+ * file is corrupt. */
+static inline int tfNext(TokenCursor *c, TokenRecord *t) {
+    uint64_t offset, length, line, column;
+    if (c->index == c->count) return 0;
+    if (!(c->p[TS_OFFSET] = getVarint(c->p[TS_OFFSET], c->end[TS_OFFSET], &offset)) ||
+        !(c->p[TS_LENGTH] = getVarint(c->p[TS_LENGTH], c->end[TS_LENGTH], &length)) ||
+        !(c->p[TS_LINE]   = getVarint(c->p[TS_LINE], c->end[TS_LINE], &line)) ||
+        !(c->p[TS_COLUMN] = getVarint(c->p[TS_COLUMN], c->end[TS_COLUMN], &column)))
+        return -1;
+    c->offset += unzigzag(offset);
+    c->line += unzigzag(line);
+    t->kind = (TokenKind)*c->p[TS_KIND]++;
+    t->offset = c->offset;
+    t->length = (uint32_t)length;
+    t->line = c->line;
+    t->column = (uint32_t)column;
+    c->index++;
+    return 1;
+}
+
+/* Whole-file decode into plain arrays, one column at a time. The kind
+ * column is used in place from the mapping. */
+typedef struct tokenColumns {
+    uint64_t count;
+    const uint8_t *kind;
+    uint64_t *offset;
+    uint32_t *length;
+    uint32_t *line;
+    uint32_t *column;
+} TokenColumns;
+
+static inline void tfFreeColumns(TokenColumns *tc) {
+    free(tc->offset); free(tc->length); free(tc->line); free(tc->column);
+    memset(tc, 0, sizeof(*tc));
+}
+
+/* Returns 0 on success, -1 if the file is corrupt or memory runs out. */
+static inline int tfLoad(const TokenFile *f, TokenColumns *tc) {
+    uint64_t n = f->count, v;
+    memset(tc, 0, sizeof(*tc));
+    tc->count = n;
+    tc->kind = f->cols[TS_KIND];
+    tc->offset = malloc(n * sizeof(uint64_t) + 1);
+    tc->length = malloc(n * sizeof(uint32_t) + 1);
+    tc->line = malloc(n * sizeof(uint32_t) + 1);
+    tc->column = malloc(n * sizeof(uint32_t) + 1);
+    if (!tc->offset || !tc->length || !tc->line || !tc->column) goto fail;
+
+    const uint8_t *p = f->cols[TS_OFFSET];
+    uint64_t offset = 0;
+    for (uint64_t i = 0; i < n; i++) {
+        if (!(p = getVarint(p, f->ends[TS_OFFSET], &v))) goto fail;
+        tc->offset[i] = offset += unzigzag(v);
+    }
+    p = f->cols[TS_LENGTH];
+    for (uint64_t i = 0; i < n; i++) {
+        if (!(p = getVarint(p, f->ends[TS_LENGTH], &v))) goto fail;
+        tc->length[i] = (uint32_t)v;
+    }
+    p = f->cols[TS_LINE];
+    uint32_t line = 0;
+    for (uint64_t i = 0; i < n; i++) {
+        if (!(p = getVarint(p, f->ends[TS_LINE], &v))) goto fail;
+        tc->line[i] = line += unzigzag(v);
+    }
+    p = f->cols[TS_COLUMN];
+    for (uint64_t i = 0; i < n; i++) {
+        if (!(p = getVarint(p, f->ends[TS_COLUMN], &v))) goto fail;
+        tc->column[i] = (uint32_t)v;
+    }
+    return 0;
+
+fail:
+    tfFreeColumns(tc);
+    return -1;
+}
+
+#endif
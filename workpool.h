@@ -0,0 +1,190 @@
+#ifndef WORKPOOL_H
+#define WORKPOOL_H
+
+/* ================= WORK-STEALING POOL =================
+ * Fixed set of worker threads, each with its own deque of tasks. A worker
+ * takes from the front of its own deque and, when that is empty, steals
+ * from the back of another's, so a worker stuck on one long task does not
+ * hold up the rest of its queue. Tasks may submit more tasks.
+ *
+ *   WorkPool wp;
+ *   wpStart(&wp, 0);                  // one worker per online CPU
+ *   wpSubmit(&wp, i % wp.workers, fn, arg);
+ *   wpWait(&wp);                      // until every task has finished
+ *   wpStop(&wp);
+ *
+ * Build with -pthread.
+ */
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+typedef void (*TaskFn)(void *arg, int worker);
+
+typedef struct task {
+    TaskFn fn;
+    void *arg;
+} Task;
+
+typedef struct taskDeque {
+    pthread_mutex_t lock;
+    Task *items;
+    int head, tail, cap;     // live tasks are items[head..tail)
+} TaskDeque;
+
+typedef struct workPool {
+    int workers;
+    TaskDeque *deques;
+    pthread_t *threads;
+    pthread_mutex_t lock;
+    pthread_cond_t wake;     // signalled when tasks are queued or on stop
+    pthread_cond_t idle;     // signalled when pending drops to 0
+    int queued;              // tasks sitting in deques
+    int pending;             // tasks submitted and not yet finished
+    int stop;
+} WorkPool;
+
+typedef struct workerArg {
+    WorkPool *wp;
+    int self;
+} WorkerArg;
+
+/* ---------------- DEQUES ---------------- */
+static void wpPush(TaskDeque *d, Task t) {
+    pthread_mutex_lock(&d->lock);
+    if (d->tail == d->cap) {
+        if (d->head > 0) {   // slide down before growing
+            memmove(d->items, d->items + d->head, (d->tail - d->head) * sizeof(Task));
+            d->tail -= d->head;
+            d->head = 0;
+        } else {
+            d->cap = d->cap ? d->cap * 2 : 64;
+            d->items = realloc(d->items, d->cap * sizeof(Task));
+        }
+    }
+    d->items[d->tail++] = t;
+    pthread_mutex_unlock(&d->lock);
+}
+
+/* Take the front task (own deque) or the back task (stealing). */
+static int wpPop(TaskDeque *d, int steal, Task *t) {
+    int got = 0;
+    pthread_mutex_lock(&d->lock);
+    if (d->head < d->tail) {
+        *t = steal ? d->items[--d->tail] : d->items[d->head++];
+        got = 1;
+    }
+    pthread_mutex_unlock(&d->lock);
+    return got;
+}
+
+static int wpTake(WorkPool *wp, int self, Task *t) {
+    int got = wpPop(&wp->deques[self], 0, t);
+    for (int i = 1; !got && i < wp->workers; i++)
+        got = wpPop(&wp->deques[(self + i) % wp->workers], 1, t);
+    if (got) {
+        pthread_mutex_lock(&wp->lock);
+        wp->queued--;
+        pthread_mutex_unlock(&wp->lock);
+    }
+    return got;
+}
+
+/* ---------------- WORKERS ---------------- */
+static void *wpWorker(void *p) {
+    WorkerArg *a = p;
+    WorkPool *wp = a->wp;
+    int self = a->self;
+    free(a);
+    for (;;) {
+        Task t;
+        if (wpTake(wp, self, &t)) {
+            t.fn(t.arg, self);
+            pthread_mutex_lock(&wp->lock);
+            if (--wp->pending == 0) pthread_cond_broadcast(&wp->idle);
+            pthread_mutex_unlock(&wp->lock);
+            continue;
+        }
+        pthread_mutex_lock(&wp->lock);
+        while (wp->queued == 0 && !wp->stop)
+            pthread_cond_wait(&wp->wake, &wp->lock);
+        int done = wp->stop && wp->queued == 0;
+        pthread_mutex_unlock(&wp->lock);
+        if (done) return NULL;
+    }
+}
+
+/* Queue fn(arg) on worker `worker`'s deque; any worker may end up running it. */
+static void wpSubmit(WorkPool *wp, int worker, TaskFn fn, void *arg) {
+    Task t = { fn, arg };
+    pthread_mutex_lock(&wp->lock);
+    wp->pending++;
+    pthread_mutex_unlock(&wp->lock);
+    wpPush(&wp->deques[worker % wp->workers], t);
+    pthread_mutex_lock(&wp->lock);
+    wp->queued++;
+    pthread_cond_signal(&wp->wake);
+    pthread_mutex_unlock(&wp->lock);
+}
+
+static inline int wpCpuCount(void) {
+    long n = sysconf(_SC_NPROCESSORS_ONLN);
+    return n > 0 ? (int)n : 1;
+}
+
+/* Start `workers` threads, or one per online CPU if workers <= 0.
+ * Returns 0, or -1 if no thread could be started. */
+static int wpStart(WorkPool *wp, int workers) {
+    memset(wp, 0, sizeof(*wp));
+    wp->workers = workers > 0 ? workers : wpCpuCount();
+    wp->deques = calloc(wp->workers, sizeof(TaskDeque));
+    wp->threads = calloc(wp->workers, sizeof(pthread_t));
+    pthread_mutex_init(&wp->lock, NULL);
+    pthread_cond_init(&wp->wake, NULL);
+    pthread_cond_init(&wp->idle, NULL);
+    for (int i = 0; i < wp->workers; i++)
+        pthread_mutex_init(&wp->deques[i].lock, NULL);
+    for (int i = 0; i < wp->workers; i++) {
+        WorkerArg *a = malloc(sizeof(*a));
+        a->wp = wp;
+        a->self = i;
+        if (pthread_create(&wp->threads[i], NULL, wpWorker, a) != 0) {
+            free(a);
+            if (i == 0) return -1;
+            wp->workers = i;     // run with the threads we got
+            break;
+        }
+    }
+    return 0;
+}
+
+/* Block until every submitted task, including ones submitted by tasks,
+ * has finished. */
+static void wpWait(WorkPool *wp) {
+    pthread_mutex_lock(&wp->lock);
+    while (wp->pending > 0)
+        pthread_cond_wait(&wp->idle, &wp->lock);
+    pthread_mutex_unlock(&wp->lock);
+}
+
+static void wpStop(WorkPool *wp) {
+    pthread_mutex_lock(&wp->lock);
+    wp->stop = 1;
+    pthread_cond_broadcast(&wp->wake);
+    pthread_mutex_unlock(&wp->lock);
+    for (int i = 0; i < wp->workers; i++)
+        pthread_join(wp->threads[i], NULL);
+    for (int i = 0; i < wp->workers; i++) {
+        pthread_mutex_destroy(&wp->deques[i].lock);
+        free(wp->deques[i].items);
+    }
+    pthread_mutex_destroy(&wp->lock);
+    pthread_cond_destroy(&wp->wake);
+    pthread_cond_destroy(&wp->idle);
+    free(wp->deques);
+    free(wp->threads);
+    memset(wp, 0, sizeof(*wp));
+}
+
+#endif